@@ -0,0 +1,1089 @@
+#include <bits/stdc++.h>
+// counts the heap allocations of the frames in check_frame_allocations
+#define COUNT_ALLOCATIONS
+#include "../utils/allocation_counter.cpp"
+#include "../softbody/softbody.h"
+#include "../softbody/spring_kernel.cpp"
+#include "../simulator.h"
+#include "../recorder.h"
+#include "../trajectory_reader.h"
+#include "../ui/scene_view.cpp"
+#include "../ui/draw_list.cpp"
+#include "lattice.cpp"
+
+using namespace std;
+
+// Steps a simulator holding one lattice body and prints the achieved steps per second.
+void bench_lattice_steps(uint w, uint h, uint steps, uint thread_count = 1)
+{
+    double mass = 0.01;
+    SoftBody *sb = make_lattice(w, h, 0.02, mass, 500, 0.1);
+    sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * mass});
+
+    Simulator s = Simulator(0, 0.5);
+    s.set_thread_count(thread_count);
+    s.add_body(sb);
+
+    auto start = chrono::steady_clock::now();
+    for (uint i = 0; i < steps; i++)
+        s.simulate_next_frame(0.001);
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "lattice " << w << "x" << h
+         << " threads: " << thread_count
+         << " nodes: " << sb->get_nodes()->size()
+         << " edges: " << sb->get_edges()->size()
+         << " steps/s: " << steps / elapsed_s << endl;
+}
+
+// Steps many independent bodies of very different sizes and prints a checksum of the final positions,
+// which has to be the same for every thread count.
+void bench_many_bodies(uint body_count, uint steps, uint thread_count)
+{
+    vector<SoftBody *> bodies;
+    Simulator s = Simulator(0, 0.5);
+    s.set_thread_count(thread_count);
+    // the bodies overlap, this measures stepping independent bodies
+    s.set_body_collisions(false, 0);
+
+    for (uint i = 0; i < body_count; i++)
+    {
+        // one big body, the rest small
+        uint size = i == 0 ? 150 : 3 + i % 8;
+        SoftBody *sb = make_lattice(size, size, 0.02, 0.01, 500, 0.1);
+        sb->move_relative({(i % 20) * 0.2, (i / 20) * 0.2});
+        sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+        s.add_body(sb);
+        bodies.push_back(sb);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (uint i = 0; i < steps; i++)
+        s.simulate_next_frame(0.001);
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double checksum = 0;
+    for (SoftBody *sb : bodies)
+    {
+        NodeStore *nodes = sb->get_nodes();
+        for (uint i = 0; i < nodes->size(); i++)
+            checksum += nodes->position[0][i] + 3 * nodes->position[1][i];
+        delete sb;
+    }
+
+    cout << "bodies " << body_count
+         << " threads: " << thread_count
+         << " steps/s: " << steps / elapsed_s
+         << " checksum: " << setprecision(17) << checksum << setprecision(6) << endl;
+}
+
+// Steps the same lattice with every spring kernel the cpu supports and compares the positions with the scalar
+// kernel. Returns false if any kernel is off by more than SPRING_KERNEL_TOLERANCE.
+bool check_spring_kernels(uint w, uint h, uint steps)
+{
+    double mass = 0.01;
+    vector<double> reference[DIMENSIONS];
+    bool ok = true;
+
+    for (int impl = spring_kernel::KERNEL_SCALAR; impl < spring_kernel::KERNEL_AUTO; impl++)
+    {
+        if (!spring_kernel::set_implementation((spring_kernel::implementation)impl))
+            continue;
+
+        SoftBody *sb = make_lattice(w, h, 0.02, mass, 500, 0.1);
+        sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * mass});
+        sb->add_velocity({0.3, -0.2});
+
+        auto start = chrono::steady_clock::now();
+        for (uint i = 0; i < steps; i++)
+            sb->advance_physics(0.001);
+        double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        NodeStore *nodes = sb->get_nodes();
+        double max_diff = 0;
+        for (uint d = 0; d < DIMENSIONS; d++)
+        {
+            if (impl == spring_kernel::KERNEL_SCALAR)
+                reference[d] = nodes->position[d];
+            for (uint i = 0; i < nodes->size(); i++)
+            {
+                double diff = fabs(nodes->position[d][i] - reference[d][i]);
+                max_diff = max(max_diff, diff / max(fabs(reference[d][i]), 1.0));
+            }
+        }
+        delete sb;
+
+        bool passed = max_diff <= SPRING_KERNEL_TOLERANCE;
+        ok = ok && passed;
+        cout << "spring kernel " << spring_kernel::get_implementation_name()
+             << " lattice " << w << "x" << h
+             << " steps/s: " << steps / elapsed_s
+             << " max rel diff: " << max_diff
+             << (passed ? " ok" : " FAILED") << endl;
+    }
+
+    spring_kernel::set_implementation(spring_kernel::KERNEL_AUTO);
+    return ok;
+}
+
+// Simulates a stiff lattice for sim_time seconds with an excited initial velocity field. Returns the wall time,
+// or a negative value if the body blew up: a non-finite position or an edge stretched past its rest length.
+double run_stiff_lattice(integration_method method, double time_step, double sim_time, uint *cg_iterations = NULL)
+{
+    double mass = 0.01;
+    SoftBody *sb = make_lattice(40, 40, 0.02, mass, 5000, 0.1);
+    sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * mass});
+    sb->set_integration_method(method);
+    NodeStore *nodes = sb->get_nodes();
+    for (uint i = 0; i < nodes->size(); i++)
+    {
+        nodes->velocity[0][i] = 0.5 * sin(i * 0.7);
+        nodes->velocity[1][i] = 0.5 * cos(i * 1.3);
+    }
+
+    uint steps = ceil(sim_time / time_step);
+    uint iterations = 0;
+    bool stable = true;
+    auto start = chrono::steady_clock::now();
+    for (uint i = 0; i < steps && stable; i++)
+    {
+        sb->advance_physics(time_step);
+        iterations += sb->get_implicit_solver()->last_iterations;
+
+        // check a few times along the way, a blown up body can come back to finite values
+        if (i % 16 == 15 || i + 1 == steps)
+        {
+            EdgeTable *edges = sb->get_edges();
+            for (uint e = 0; e < edges->size() && stable; e++)
+                stable = isfinite(edges->deformation[e]) && fabs(edges->deformation[e]) < edges->rest_length[e];
+        }
+    }
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    delete sb;
+
+    if (cg_iterations != NULL)
+        *cg_iterations = iterations / max(steps, 1u);
+    return stable ? elapsed_s : -1;
+}
+
+// Finds the largest stable time step of the explicit integrator on a stiff lattice, then compares its wall time
+// for the same simulated time with the implicit integrator at multiples of that step, up to its own largest
+// stable step.
+void bench_implicit_vs_explicit(double sim_time)
+{
+    double explicit_step = 1. / 30;
+    double explicit_s = -1;
+    while (explicit_step > 1e-6 && (explicit_s = run_stiff_lattice(INTEGRATE_EXPLICIT, explicit_step, sim_time)) < 0)
+        explicit_step /= 2;
+    cout << "explicit stiff lattice 40x40 largest stable step: " << explicit_step
+         << " wall s per " << sim_time << " sim s: " << explicit_s << endl;
+
+    for (double multiple : {1, 4, 10, 16, 24, 32, 128})
+    {
+        uint cg_iterations = 0;
+        double time_step = explicit_step * multiple;
+        double elapsed_s = run_stiff_lattice(INTEGRATE_IMPLICIT, time_step, sim_time, &cg_iterations);
+        cout << "implicit stiff lattice 40x40 step: " << time_step << " (" << multiple << "x)";
+        if (elapsed_s < 0)
+            cout << " unstable" << endl;
+        else
+            cout << " wall s per " << sim_time << " sim s: " << elapsed_s
+                 << " speedup: " << explicit_s / elapsed_s
+                 << " cg iterations/step: " << cg_iterations << endl;
+    }
+}
+
+// XPBD on the same stiff lattice at frame sized steps, the cost per step only depends on substeps and iterations.
+void bench_xpbd(double sim_time)
+{
+    for (double time_step : {1. / 240, 1. / 60, 1. / 30})
+    {
+        double elapsed_s = run_stiff_lattice(INTEGRATE_XPBD, time_step, sim_time);
+        cout << "xpbd stiff lattice 40x40 step: " << time_step;
+        if (elapsed_s < 0)
+            cout << " unstable" << endl;
+        else
+            cout << " wall s per " << sim_time << " sim s: " << elapsed_s
+                 << " ms/step: " << elapsed_s * 1000 / ceil(sim_time / time_step) << endl;
+    }
+}
+
+// Drops a lattice onto the floor frame by frame with adaptive stepping and prints the step sizes it chose, next to
+// the cost of a small fixed step. Damping is applied per step, so the two runs don't end in the same state.
+void bench_adaptive(double sim_time, double tolerance)
+{
+    const double frame_time = 1. / 60;
+    for (uint adaptive = 0; adaptive < 2; adaptive++)
+    {
+        double mass = 0.01;
+        SoftBody *sb = make_lattice(20, 20, 0.05, mass, 500, 0.1);
+        sb->move_relative({1, 1});
+        sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * mass});
+
+        Simulator s = Simulator(0, 0.5);
+        s.add_body(sb);
+        if (adaptive)
+            s.set_adaptive_stepping(true, tolerance, 1e-5, frame_time);
+
+        uint frames = round(sim_time / frame_time);
+        double fixed_dt = 1e-4;
+        auto start = chrono::steady_clock::now();
+        for (uint f = 0; f < frames; f++)
+        {
+            if (adaptive)
+                s.simulate_next_frame(frame_time);
+            else
+                for (uint i = 0; i < round(frame_time / fixed_dt); i++)
+                    s.simulate_next_frame(fixed_dt);
+        }
+        double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        delete sb;
+
+        if (!adaptive)
+        {
+            cout << "fixed dt: " << fixed_dt << " lattice 20x20 " << sim_time << " sim s, wall s: " << elapsed_s << endl;
+            continue;
+        }
+
+        vector<double> history;
+        s.get_dt_history(&history);
+        double min_dt = *min_element(history.begin(), history.end());
+        double max_dt = *max_element(history.begin(), history.end());
+
+        cout << "adaptive tolerance: " << tolerance << " lattice 20x20 " << sim_time << " sim s, wall s: " << elapsed_s
+             << " steps: " << history.size() << " rejected: " << s.get_rejected_steps()
+             << " dt min/mean/max: " << min_dt << "/" << sim_time / history.size() << "/" << max_dt << endl;
+    }
+}
+
+// Builds each mesh generator's body at about node_count nodes and prints the construction time.
+void bench_mesh_construction(uint node_count)
+{
+    auto timed = [&](const string &name, auto build) {
+        SoftBody sb;
+        auto start = chrono::steady_clock::now();
+        build(&sb);
+        double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "build " << name
+             << " nodes: " << sb.get_nodes()->size()
+             << " edges: " << sb.get_edges()->size()
+             << " s: " << elapsed_s << endl;
+    };
+
+    uint side = round(sqrt(node_count));
+    timed("grid", [&](SoftBody *sb) {
+        meshes::build_grid(sb, {}, side, side, 0.01, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR | meshes::GRID_BEND);
+    });
+    timed("ring", [&](SoftBody *sb) { meshes::build_ring(sb, {}, 1, node_count, 0.01, 500, 0.1); });
+    timed("disk", [&](SoftBody *sb) { meshes::build_disk(sb, {}, 1, round(sqrt(node_count / 3.)), 0.01, 500, 0.1); });
+    timed("rope", [&](SoftBody *sb) { meshes::build_rope(sb, {}, {10, 0}, node_count - 1, 0.01, 500, 0.1); });
+    // a star, concave between the points
+    vector<vec_t> star;
+    for (uint i = 0; i < 10; i++)
+    {
+        double r = i % 2 ? 0.4 : 1;
+        star.push_back({r * cos(M_PI * i / 5), r * sin(M_PI * i / 5)});
+    }
+    // the star covers about 1.2 square meters, a node of the lattice about 0.87 spacing^2
+    timed("polygon", [&](SoftBody *sb) { meshes::build_polygon(sb, star, sqrt(1.2 / 0.87 / node_count), 0.01, 500, 0.1); });
+}
+
+// Drops a grid of small bodies into a box where they pile up on each other, then prints steps/s and the number of
+// node-edge contacts of the last step.
+void bench_colliding_bodies(uint body_count, uint steps, uint thread_count)
+{
+    vector<SoftBody *> bodies;
+    Simulator s = Simulator(0.2, 0.5);
+    s.set_thread_count(thread_count);
+    s.set_body_collisions(true, 0.01);
+
+    uint per_row = ceil(sqrt(body_count * 2.));
+    // make_lattice starts bodies at 0.5
+    s.dsp_w_m = per_row * 0.075 + 1;
+    s.dsp_h_m = s.dsp_w_m;
+    for (uint i = 0; i < body_count; i++)
+    {
+        SoftBody *sb = make_lattice(3, 3, 0.03, 0.01, 500, 0.1);
+        sb->move_relative({0.02 + (i % per_row) * 0.075, 0.02 + (i / per_row) * 0.075});
+        sb->add_velocity({(i % 7) * 0.2 - 0.6, 0});
+        sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+        s.add_body(sb);
+        bodies.push_back(sb);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (uint i = 0; i < steps; i++)
+        s.simulate_next_frame(0.0005);
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double checksum = 0;
+    for (SoftBody *sb : bodies)
+    {
+        NodeStore *nodes = sb->get_nodes();
+        for (uint i = 0; i < nodes->size(); i++)
+            checksum += nodes->position[0][i] + 3 * nodes->position[1][i];
+        delete sb;
+    }
+
+    cout << "colliding bodies " << body_count
+         << " threads: " << thread_count
+         << " steps/s: " << steps / elapsed_s
+         << " contacts: " << s.get_contact_count()
+         << " checksum: " << setprecision(17) << checksum << setprecision(6) << endl;
+}
+
+// Drops small bodies onto the floor in stacks of two and lets them settle, then steps the resting scene with and
+// without sleeping. Prints steps/s of both and the awake and sleeping bodies, then pulls a node of one body and
+// prints the counts again.
+void bench_sleeping(uint body_count, uint steps)
+{
+    double results[2];
+    for (uint mode = 0; mode < 2; mode++)
+    {
+        bool sleeping = mode == 1;
+        vector<SoftBody *> bodies;
+        Simulator s = Simulator(0, 0.5);
+        s.set_body_collisions(true, 0.01);
+        s.set_sleeping(sleeping, 1e-3, 60);
+
+        uint per_row = (body_count + 1) / 2;
+        s.dsp_w_m = per_row * 0.1 + 1;
+        s.dsp_h_m = 0.7;
+        for (uint i = 0; i < body_count; i++)
+        {
+            // make_lattice starts bodies at 0.5, the floor is at 0.7
+            SoftBody *sb = make_lattice(3, 3, 0.03, 0.01, 500, 0.1);
+            sb->move_relative({(i % per_row) * 0.1, 0.09 - (i / per_row) * 0.08});
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            s.add_body(sb);
+            bodies.push_back(sb);
+        }
+
+        // settle for 2 simulated seconds
+        for (uint i = 0; i < 4000; i++)
+            s.simulate_next_frame(0.0005);
+        uint settled_sleeping = s.get_sleeping_body_count();
+
+        auto start = chrono::steady_clock::now();
+        for (uint i = 0; i < steps; i++)
+            s.simulate_next_frame(0.0005);
+        results[mode] = steps / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "resting bodies " << body_count << " sleeping " << (sleeping ? "on " : "off")
+             << " steps/s: " << results[mode]
+             << " awake: " << s.get_awake_body_count()
+             << " sleeping: " << s.get_sleeping_body_count()
+             << " (after settling: " << settled_sleeping << ")";
+        if (sleeping)
+        {
+            bodies[0]->get_node(0).set_force(FORCE_PULL, {0, -0.5});
+            s.simulate_next_frame(0.0005);
+            cout << " after pull awake: " << s.get_awake_body_count()
+                 << " sleeping: " << s.get_sleeping_body_count();
+        }
+        cout << endl;
+
+        for (SoftBody *sb : bodies)
+            delete sb;
+    }
+    cout << "sleeping speedup: " << results[1] / results[0] << endl;
+}
+
+// Steps a lattice once without and once while recording it, prints steps/s of both, the frames written and dropped
+// and the size of the recording per node and frame against 16 bytes of raw doubles. Then reads the recording back
+// forwards and backwards, reading backwards shouldn't cost much more.
+void bench_recorder(uint w, uint h, uint steps)
+{
+    string path = (filesystem::temp_directory_path() / "softbody_recorder_bench.bin").string();
+    double results[2];
+    for (uint mode = 0; mode < 2; mode++)
+    {
+        SoftBody *sb = make_lattice(w, h, 0.02, 0.01, 500, 0.1);
+        sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+        sb->add_velocity({0.3, -0.2});
+        Simulator s = Simulator(0, 0.5);
+        s.dsp_w_m = w * 0.02 + 1;
+        s.dsp_h_m = h * 0.02 + 1;
+        s.add_body(sb);
+
+        unique_ptr<TrajectoryRecorder> recorder;
+        if (mode == 1)
+        {
+            recorder.reset(new TrajectoryRecorder(path));
+            s.set_frame_listener(recorder.get());
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (uint i = 0; i < steps; i++)
+            s.simulate_next_frame(0.001);
+        results[mode] = steps / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (recorder)
+        {
+            s.set_frame_listener(NULL);
+            bool ok = recorder->close();
+            uint64_t frames = recorder->get_recorded_frames();
+            cout << "recording lattice " << w << "x" << h
+                 << " steps/s: " << results[1] << " (not recording: " << results[0] << ")"
+                 << " frames: " << frames
+                 << " dropped: " << recorder->get_dropped_frames()
+                 << " MB: " << recorder->get_bytes_written() / 1e6
+                 << " bytes per node and frame: " << (frames ? (double)recorder->get_bytes_written() / frames / sb->get_nodes()->size() : 0)
+                 << (ok ? "" : " write FAILED") << endl;
+        }
+        delete sb;
+    }
+
+    TrajectoryReader reader(path);
+    uint64_t frames = reader.get_frame_count();
+    double read_ms[2] = {0, 0};
+    for (uint reverse = 0; reverse < 2; reverse++)
+    {
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < frames; i++)
+            reader.read_frame(reverse ? frames - 1 - i : i);
+        read_ms[reverse] = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / max(frames, (uint64_t)1);
+    }
+    cout << "replaying lattice " << w << "x" << h
+         << " ms per frame forwards: " << read_ms[0]
+         << " backwards: " << read_ms[1] << endl;
+    remove(path.c_str());
+}
+
+// Records bodies that tear and a body added halfway in small chunks, then reads the frames back backwards and in
+// random order. Every position has to be within half a quantum of the simulated one and every body has to have the
+// edges it had in that frame.
+bool check_replay(uint steps)
+{
+    string path = (filesystem::temp_directory_path() / "softbody_replay_check.bin").string();
+    double quantum = 1e-6;
+    Simulator s = Simulator(0.2, 0.5);
+    s.dsp_w_m = 2;
+    s.dsp_h_m = 1;
+    SoftBody *lattice = make_lattice(8, 8, 0.03, 0.01, 500, 0.1);
+    lattice->add_velocity({0.5, -0.3});
+    lattice->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+    SoftBody *torn = new SoftBody(1, 1, 0.02);
+    meshes::build_grid(torn, {0.8, 0.3}, 6, 6, 0.03, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+    torn->get_node(0).set_force(FORCE_PULL, {30, 0});
+    SoftBody *added = make_lattice(4, 4, 0.03, 0.01, 500, 0.1);
+    added->move_relative({1.4, 0.2});
+    s.add_body(lattice);
+    s.add_body(torn);
+
+    // positions and edges of every frame as the recorder saw them
+    vector<vector<double>> positions;
+    vector<vector<vector<uint>>> edges;
+    TrajectoryRecorder *recorder = new TrajectoryRecorder(path, quantum, 64 << 20, 16);
+    s.set_frame_listener(recorder);
+    for (uint i = 0; i < steps; i++)
+    {
+        if (i == steps / 2)
+            s.add_body(added);
+        s.simulate_next_frame(0.0005);
+        positions.emplace_back();
+        edges.emplace_back();
+        for (uint b = 0; b < s.get_body_count(); b++)
+        {
+            NodeStore *nodes = s.get_body(b)->get_nodes();
+            for (uint d = 0; d < DIMENSIONS; d++)
+                positions.back().insert(positions.back().end(), nodes->position[d].begin(), nodes->position[d].end());
+            EdgeTable *table = s.get_body(b)->get_edges();
+            edges.back().emplace_back();
+            for (uint e = 0; e < table->size(); e++)
+            {
+                edges.back().back().push_back(table->node1[e]);
+                edges.back().back().push_back(table->node2[e]);
+            }
+        }
+    }
+    s.set_frame_listener(NULL);
+    bool ok = recorder->close();
+    delete recorder;
+
+    TrajectoryReader reader(path);
+    uint64_t frames = reader.get_frame_count();
+    ok = ok && reader.good() && frames > 0;
+    vector<uint64_t> order;
+    for (uint64_t i = 0; i < frames; i++)
+        order.push_back(frames - 1 - i);
+    mt19937 rng(7);
+    for (uint64_t i = 0; i < frames; i++)
+        order.push_back(rng() % frames);
+
+    double max_error = 0;
+    for (uint64_t i : order)
+    {
+        const trajectory_frame_t *frame = reader.read_frame(i);
+        if (frame == NULL || frame->frame >= steps || frame->positions.size() != positions[frame->frame].size()
+            || frame->body_edges != edges[frame->frame] || reader.find_frame(frame->time) != i)
+        {
+            ok = false;
+            break;
+        }
+        for (size_t j = 0; j < frame->positions.size(); j++)
+            max_error = max(max_error, abs(frame->positions[j] - positions[frame->frame][j]));
+    }
+    ok = ok && max_error <= quantum / 2;
+    remove(path.c_str());
+
+    cout << "replay frames: " << frames << " of " << steps
+         << " torn edges: " << edges[0][1].size() / 2 - torn->get_edges()->size()
+         << " max position error: " << max_error
+         << (ok ? " ok" : " FAILED") << endl;
+    delete lattice;
+    delete torn;
+    delete added;
+    return ok;
+}
+
+// positions and velocities of every node of the simulator, body after body
+static vector<double> simulator_state(Simulator *s)
+{
+    vector<double> state;
+    for (uint b = 0; b < s->get_body_count(); b++)
+    {
+        NodeStore *nodes = s->get_body(b)->get_nodes();
+        for (uint d = 0; d < DIMENSIONS; d++)
+        {
+            state.insert(state.end(), nodes->position[d].begin(), nodes->position[d].end());
+            state.insert(state.end(), nodes->velocity[d].begin(), nodes->velocity[d].end());
+        }
+        state.push_back(s->get_body(b)->get_edges()->size());
+    }
+    return state;
+}
+
+// Runs a scene of colliding bodies with every integrator, tearing and deforming bodies and sleeping, with fixed and adaptive
+// steps. The scene is checkpointed halfway, then the rest is run once on and once from the restored checkpoint on
+// another thread count, the two have to end bit for bit the same. Then times saving and restoring a grid of about
+// node_count nodes.
+bool check_checkpoint(uint steps, uint node_count)
+{
+    string path = (filesystem::temp_directory_path() / "softbody_checkpoint_bench.bin").string();
+    bool ok = true;
+
+    for (uint adaptive = 0; adaptive < 2; adaptive++)
+    {
+        vector<SoftBody *> bodies;
+        Simulator s = Simulator(0.2, 0.5);
+        s.set_body_collisions(true, 0.01);
+        s.set_sleeping(true, 1e-2, 20);
+        if (adaptive)
+            s.set_adaptive_stepping(true, 1e-5, 1e-5, 5e-4);
+        s.dsp_w_m = 2;
+        s.dsp_h_m = 1;
+        for (uint i = 0; i < 24; i++)
+        {
+            SoftBody *sb = make_lattice(3, 3, 0.03, 0.01, 500, 0.1);
+            sb->set_integration_method((integration_method)(i % 3));
+            sb->move_relative({(i % 12) * 0.1, (i / 12) * 0.1});
+            sb->add_velocity({(i % 5) * 0.2 - 0.4, 0});
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            bodies.push_back(sb);
+        }
+        // pulled until its springs tear, and one pulled until its springs keep their deformation
+        SoftBody *torn = new SoftBody(1, 1, 0.02);
+        SoftBody *deformed = new SoftBody(0.005, 1, 1);
+        meshes::build_grid(torn, {0.2, 0.3}, 6, 6, 0.03, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+        meshes::build_grid(deformed, {1.2, 0.3}, 6, 6, 0.03, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+        torn->get_node(0).set_force(FORCE_PULL, {30, 0});
+        deformed->get_node(0).set_force(FORCE_PULL, {5, 0});
+        uint edges_built = torn->get_edges()->size();
+        double rest_built = accumulate(deformed->get_edges()->rest_length.begin(), deformed->get_edges()->rest_length.end(), 0.);
+        bodies.push_back(torn);
+        bodies.push_back(deformed);
+        for (SoftBody *sb : bodies)
+            s.add_body(sb);
+
+        for (uint i = 0; i < steps; i++)
+            s.simulate_next_frame(0.0005);
+        uint edges_before = torn->get_edges()->size();
+        bool saved = s.save_checkpoint(path);
+        for (uint i = 0; i < steps; i++)
+            s.simulate_next_frame(0.0005);
+        vector<double> expected = simulator_state(&s);
+
+        Simulator restored;
+        restored.set_thread_count(max(thread::hardware_concurrency(), 2u));
+        bool loaded = saved && restored.restore_checkpoint(path);
+        for (uint i = 0; loaded && i < steps; i++)
+            restored.simulate_next_frame(0.0005);
+        bool identical = loaded && simulator_state(&restored) == expected;
+        ok = ok && identical;
+
+        cout << "checkpoint " << (adaptive ? "adaptive" : "fixed") << " steps"
+             << " bodies: " << bodies.size()
+             << " torn edges: " << edges_built - edges_before << " then " << edges_built - torn->get_edges()->size()
+             << " rest length gained: " << accumulate(deformed->get_edges()->rest_length.begin(), deformed->get_edges()->rest_length.end(), 0.) - rest_built
+             << " sleeping: " << s.get_sleeping_body_count()
+             << " contacts: " << s.get_contact_count()
+             << (identical ? " restored run bit identical" : " restored run FAILED") << endl;
+        for (SoftBody *sb : bodies)
+            delete sb;
+    }
+
+    uint side = round(sqrt(node_count));
+    Simulator s = Simulator(0, 0.5);
+    SoftBody sb;
+    meshes::build_grid(&sb, {0.5, 0.5}, side, side, 0.01, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+    s.add_body(&sb);
+    s.simulate_next_frame(0.0001);
+
+    auto start = chrono::steady_clock::now();
+    bool saved = s.save_checkpoint(path);
+    double save_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    uint64_t file_size = saved ? filesystem::file_size(path) : 0;
+    Simulator restored;
+    start = chrono::steady_clock::now();
+    bool loaded = saved && restored.restore_checkpoint(path);
+    double restore_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bool same = loaded && simulator_state(&restored) == simulator_state(&s);
+    ok = ok && same;
+    remove(path.c_str());
+
+    cout << "checkpoint grid nodes: " << sb.get_nodes()->size()
+         << " edges: " << sb.get_edges()->size()
+         << " MB: " << file_size / 1e6
+         << " save s: " << save_s
+         << " restore s: " << restore_s
+         << (same ? " ok" : " FAILED") << endl;
+    return ok;
+}
+
+// Prints the cost of a scope with the profiler disabled and enabled, and steps/s of colliding bodies on
+// thread_count threads without and with profiling. Then prints the summary of the profiled run and writes its trace.
+void bench_profiler(uint body_count, uint steps, uint thread_count)
+{
+    const uint scopes = 10000000;
+    double scope_ns[2];
+    for (uint enabled = 0; enabled < 2; enabled++)
+    {
+        utils::Profiler::set_enabled(enabled);
+        auto start = chrono::steady_clock::now();
+        for (uint i = 0; i < scopes; i++)
+        {
+            PROFILE_SCOPE("bench_profiler");
+            asm volatile("" ::: "memory");
+        }
+        scope_ns[enabled] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / scopes;
+    }
+    utils::Profiler::set_enabled(false);
+    utils::Profiler::clear();
+
+    double results[2];
+    for (uint enabled = 0; enabled < 2; enabled++)
+    {
+        vector<SoftBody *> bodies;
+        Simulator s = Simulator(0.2, 0.5);
+        s.set_thread_count(thread_count);
+        s.set_body_collisions(true, 0.01);
+        uint per_row = ceil(sqrt(body_count * 2.));
+        s.dsp_w_m = per_row * 0.075 + 1;
+        s.dsp_h_m = s.dsp_w_m;
+        for (uint i = 0; i < body_count; i++)
+        {
+            SoftBody *sb = make_lattice(3, 3, 0.03, 0.01, 500, 0.1);
+            sb->move_relative({0.02 + (i % per_row) * 0.075, 0.02 + (i / per_row) * 0.075});
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            s.add_body(sb);
+            bodies.push_back(sb);
+        }
+
+        utils::Profiler::set_enabled(enabled);
+        auto start = chrono::steady_clock::now();
+        for (uint i = 0; i < steps; i++)
+            s.simulate_next_frame(0.0005);
+        results[enabled] = steps / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        utils::Profiler::set_enabled(false);
+        for (SoftBody *sb : bodies)
+            delete sb;
+    }
+
+    string path = (filesystem::temp_directory_path() / "softbody_profile_bench.json").string();
+    bool written = utils::Profiler::write_chrome_trace(path);
+    cout << "profiler scope ns disabled: " << scope_ns[0] << " enabled: " << scope_ns[1]
+         << " colliding bodies " << body_count << " threads: " << thread_count
+         << " steps/s: " << results[1] << " (not profiling: " << results[0] << ")"
+         << " events: " << utils::Profiler::get_events().size()
+         << " trace KB: " << (written ? filesystem::file_size(path) / 1e3 : 0) << (written ? "" : " write FAILED") << endl;
+    utils::Profiler::print_summary(cout);
+    utils::Profiler::clear();
+    remove(path.c_str());
+}
+
+// Runs the frames of the Ui without a renderer: update the view, build the draw list of the packed positions and
+// edge nodes and step the simulation. The scene is small bodies of every integrator falling onto big ones,
+// with sleeping, on 1 and 2 threads and with fixed and adaptive steps. After warm_up frames, the frames must not
+// allocate.
+bool check_frame_allocations(uint warm_up, uint frames)
+{
+    bool ok = true;
+    for (uint config = 0; config < 4; config++)
+    {
+        bool adaptive = config & 1;
+        uint thread_count = config & 2 ? 2 : 1;
+        vector<SoftBody *> bodies;
+        Simulator s = Simulator(0.2, 0.5);
+        s.set_thread_count(thread_count);
+        s.set_body_collisions(true, 0.01);
+        s.set_sleeping(true, 1e-3, 200);
+        if (adaptive)
+            s.set_adaptive_stepping(true, 1e-4, 1e-4, 5e-4);
+        s.dsp_w_m = 2.5;
+        s.dsp_h_m = 1.5;
+        for (uint i = 0; i < 24; i++)
+        {
+            // big bodies on the floor, 7 small ones above each
+            bool big = i < 3;
+            SoftBody *sb = make_lattice(big ? 20 : 3, big ? 20 : 3, 0.01, 0.01, 500, 0.1);
+            sb->set_integration_method((integration_method)(i % 3));
+            if (big)
+                sb->move_relative({i * 0.6 - 0.2, 0.8});
+            else
+                sb->move_relative({(i - 3) / 7 * 0.6 - 0.2 + (i - 3) % 7 * 0.025, 0.75});
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            s.add_body(sb);
+            bodies.push_back(sb);
+        }
+
+        SceneView view;
+        DrawList draw_list;
+        double sum = 0;
+        uint64_t allocations = 0;
+        for (uint f = 0; f < warm_up + frames; f++)
+        {
+            uint64_t start = utils::allocation_count().load();
+            view.update(&s);
+            utils::span<vec_t> positions = s.get_positions();
+            utils::span<uint> edge_nodes = s.get_edge_nodes();
+            draw_list.clear();
+            draw_list.add_lines(positions, edge_nodes, {{93, 196, 255, 1}, 0.016});
+            draw_list.add_circles(positions, 0.04, {{245, 253, 255, 1}, 0});
+            sum += draw_list.get_points()[0][0] + positions[positions.size() - 1][1];
+            for (uint i = 0; i < 2; i++)
+                s.simulate_next_frame(0.0005);
+            if (f >= warm_up)
+                allocations += utils::allocation_count().load() - start;
+        }
+        ok = ok && allocations == 0;
+
+        cout << "frame allocations " << (adaptive ? "adaptive" : "fixed") << " steps threads: " << thread_count
+             << " frames: " << frames
+             << " allocations: " << allocations
+             << " view rebuilds: " << view.get_rebuilds()
+             << " sleeping: " << s.get_sleeping_body_count()
+             << " contacts: " << s.get_contact_count()
+             << (sum == sum ? "" : " nan")
+             << (allocations == 0 ? " ok" : " FAILED") << endl;
+        for (SoftBody *sb : bodies)
+            delete sb;
+    }
+    return ok;
+}
+
+// Steps a lattice, a tearing body and a body added halfway and compares the packed positions, edge nodes and node
+// starts with the bodies after every step. Then times a drawing pass, the length of every edge, over a w x h
+// lattice after each step, once through the packed spans and once through get_all_edges and the Node getters.
+bool check_spans(uint steps, uint w, uint h)
+{
+    Simulator s = Simulator(0.2, 0.5);
+    s.dsp_w_m = 2;
+    s.dsp_h_m = 1;
+    SoftBody *lattice = make_lattice(8, 8, 0.03, 0.01, 500, 0.1);
+    lattice->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+    SoftBody *torn = new SoftBody(1, 1, 0.02);
+    meshes::build_grid(torn, {0.8, 0.3}, 6, 6, 0.03, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+    torn->get_node(0).set_force(FORCE_PULL, {30, 0});
+    SoftBody *added = make_lattice(4, 4, 0.03, 0.01, 500, 0.1);
+    added->move_relative({1.4, 0.2});
+    s.add_body(lattice);
+    s.add_body(torn);
+    uint torn_edges = torn->get_edges()->size();
+
+    bool ok = true;
+    for (uint i = 0; i < steps; i++)
+    {
+        if (i == steps / 2)
+            s.add_body(added);
+        if (i == steps / 4)
+        {
+            // reordered edges keep their count, the spans have to follow them anyway
+            EdgeTable *edges = lattice->get_edges();
+            vector<uint> order(edges->size());
+            iota(order.rbegin(), order.rend(), 0);
+            edges->permute(order);
+            edges->coloring_valid = false;
+        }
+        s.simulate_next_frame(0.0005);
+        utils::span<vec_t> positions = s.get_positions();
+        utils::span<uint> edge_nodes = s.get_edge_nodes();
+        utils::span<uint> starts = s.get_node_starts();
+        ok = ok && starts.size() == s.get_body_count() + 1 && positions.size() == starts[s.get_body_count()];
+        size_t next_edge = 0;
+        for (uint b = 0; ok && b < s.get_body_count(); b++)
+        {
+            NodeStore *nodes = s.get_body(b)->get_nodes();
+            EdgeTable *edges = s.get_body(b)->get_edges();
+            ok = starts[b + 1] - starts[b] == nodes->size();
+            for (uint n = 0; ok && n < nodes->size(); n++)
+                for (uint d = 0; d < DIMENSIONS; d++)
+                    ok = ok && positions[starts[b] + n][d] == nodes->position[d][n];
+            for (uint e = 0; ok && e < edges->size(); e++, next_edge += 2)
+                ok = next_edge + 1 < edge_nodes.size()
+                    && edge_nodes[next_edge] == starts[b] + edges->node1[e]
+                    && edge_nodes[next_edge + 1] == starts[b] + edges->node2[e];
+        }
+        ok = ok && next_edge == edge_nodes.size();
+        // packed once per step
+        ok = ok && s.get_positions().data() == positions.data() && s.get_edge_nodes().data() == edge_nodes.data();
+    }
+    torn_edges -= torn->get_edges()->size();
+    cout << "spans steps: " << steps << " bodies: " << s.get_body_count() << " edges torn: " << torn_edges
+         << (ok && torn_edges > 0 ? " ok" : " FAILED") << endl;
+    delete lattice;
+    delete torn;
+    delete added;
+    if (!ok || torn_edges == 0)
+        return false;
+
+    SoftBody *big = make_lattice(w, h, 0.005, 0.01, 500, 0.1);
+    Simulator drawn = Simulator(0, 0.5);
+    drawn.add_body(big);
+    uint passes = 20;
+    double elapsed_s[2] = {0, 0}, lengths[2] = {0, 0};
+    for (uint p = 0; p < passes; p++)
+    {
+        drawn.simulate_next_frame(0.0005);
+        auto start = chrono::steady_clock::now();
+        utils::span<vec_t> positions = drawn.get_positions();
+        utils::span<uint> edge_nodes = drawn.get_edge_nodes();
+        for (size_t e = 0; e < edge_nodes.size(); e += 2)
+            lengths[0] += vector_len(positions[edge_nodes[e + 1]] - positions[edge_nodes[e]]);
+        auto middle = chrono::steady_clock::now();
+        vector<Edge> edges;
+        drawn.get_all_edges(&edges);
+        for (Edge &edge : edges)
+            lengths[1] += vector_len(edge.get_node2().get_position() - edge.get_node1().get_position());
+        auto end = chrono::steady_clock::now();
+        elapsed_s[0] += chrono::duration<double>(middle - start).count();
+        elapsed_s[1] += chrono::duration<double>(end - middle).count();
+    }
+    cout << "drawing pass edges: " << big->get_edges()->size()
+         << " ms spans: " << elapsed_s[0] / passes * 1000
+         << " get_all_edges: " << elapsed_s[1] / passes * 1000
+         << " speedup: " << elapsed_s[1] / elapsed_s[0]
+         << (fabs(lengths[0] - lengths[1]) <= 1e-9 * lengths[1] ? "" : " lengths differ") << endl;
+    delete big;
+    return true;
+}
+
+// Checks that the draw list batches consecutive primitives of the same kind and style and keeps their points in
+// order, then prints the ms of building the list of a lattice of w x h nodes, every edge and node.
+bool check_draw_list(uint w, uint h, uint frames)
+{
+    vector<vec_t> positions = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    vector<uint> ends = {0, 1, 1, 2, 2, 3, 3};
+    utils::span<vec_t> points(positions.data(), positions.size());
+    DrawList::style_t edge = {{93, 196, 255, 1}, 0.016}, other = {{93, 196, 255, 1}, 0.02};
+    DrawList::style_t node = {{245, 253, 255, 1}, 0};
+    DrawList list;
+    list.add_lines(points, utils::span<uint>(ends.data(), 4), edge);
+    // the odd end is left out
+    list.add_lines(points, utils::span<uint>(ends.data() + 4, 3), edge);
+    list.add_lines(points, utils::span<uint>(ends.data(), 2), other);
+    list.add_circles(points, 0.04, node);
+    list.add_circles(points, 0.05, node);
+    list.add_lines(points, utils::span<uint>(), other);
+
+    const vector<DrawList::batch_t> &batches = list.get_batches();
+    bool ok = batches.size() == 4 && list.get_point_count() == 6 + 2 + 4 + 4
+        && batches[0].kind == DrawList::LINES && batches[0].begin == 0 && batches[0].end == 6
+        && batches[1].kind == DrawList::LINES && batches[1].end == 8 && batches[1].style.line_width == 0.02
+        && batches[2].kind == DrawList::CIRCLES && batches[2].radius == 0.04 && batches[2].end == 12
+        && batches[3].kind == DrawList::CIRCLES && batches[3].radius == 0.05 && batches[3].end == 16;
+    uint expected[] = {0, 1, 1, 2, 2, 3, 0, 1, 0, 1, 2, 3, 0, 1, 2, 3};
+    for (uint i = 0; ok && i < list.get_point_count(); i++)
+        ok = list.get_points()[i][0] == positions[expected[i]][0] && list.get_points()[i][1] == positions[expected[i]][1];
+    list.clear();
+    ok = ok && list.get_batches().empty() && list.get_point_count() == 0;
+
+    SoftBody *sb = make_lattice(w, h, 0.005, 0.01, 500, 0.1);
+    Simulator s = Simulator(0, 0.5);
+    s.add_body(sb);
+    s.simulate_next_frame(0.0005);
+    double elapsed_s = 0;
+    for (uint f = 0; f <= frames; f++)
+    {
+        auto start = chrono::steady_clock::now();
+        list.clear();
+        list.add_lines(s.get_positions(), s.get_edge_nodes(), edge);
+        list.add_circles(s.get_positions(), 0.04, node);
+        // the first frame grows the list
+        if (f > 0)
+            elapsed_s += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    cout << "draw list edges: " << sb->get_edges()->size() << " nodes: " << sb->get_nodes()->size()
+         << " batches: " << list.get_batches().size() << " ms/frame: " << elapsed_s / frames * 1000
+         << (ok ? " ok" : " FAILED") << endl;
+    delete sb;
+    return ok;
+}
+
+// FNV-1a of the bytes of the simulator's state, see simulator_state
+static uint64_t state_hash(Simulator *s)
+{
+    vector<double> state = simulator_state(s);
+    const uint8_t *bytes = (const uint8_t *)state.data();
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < state.size() * sizeof(double); i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Runs colliding bodies of every integrator, a tearing body and lattices big enough to be split between threads
+// for steps on 1, 2, 3, 4 and 8 threads, once deterministic and once not, and hashes the states. The deterministic
+// runs have to hash the same. Then prints steps/s of an implicit lattice of w x h nodes with either mode.
+bool check_determinism(uint steps, uint w, uint h)
+{
+    auto run = [&](uint thread_count, bool deterministic) {
+        vector<SoftBody *> bodies;
+        Simulator s = Simulator(0.2, 0.5);
+        s.set_thread_count(thread_count);
+        s.set_deterministic(deterministic);
+        s.set_body_collisions(true, 0.01);
+        s.set_sleeping(true, 1e-2, 20);
+        s.dsp_w_m = 6;
+        s.dsp_h_m = 3;
+        for (uint i = 0; i < 24; i++)
+        {
+            SoftBody *sb = make_lattice(3, 3, 0.03, 0.01, 500, 0.1);
+            sb->set_integration_method((integration_method)(i % 3));
+            sb->move_relative({(i % 12) * 0.1, (i / 12) * 0.1});
+            sb->add_velocity({(i % 5) * 0.2 - 0.4, 0});
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            bodies.push_back(sb);
+        }
+        SoftBody *torn = new SoftBody(1, 1, 0.02);
+        meshes::build_grid(torn, {0.2, 0.5}, 6, 6, 0.03, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+        torn->get_node(0).set_force(FORCE_PULL, {30, 0});
+        bodies.push_back(torn);
+        for (uint m = 0; m < 3; m++)
+        {
+            SoftBody *sb = make_lattice(64, 64, 0.01, 0.01, 500, 0.1);
+            sb->set_integration_method((integration_method)m);
+            sb->move_relative({1.5 + m * 1.4, 1.2});
+            sb->add_velocity({0.3, -0.2});
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            bodies.push_back(sb);
+        }
+        for (SoftBody *sb : bodies)
+            s.add_body(sb);
+
+        for (uint i = 0; i < steps; i++)
+            s.simulate_next_frame(0.0005);
+        uint64_t hash = state_hash(&s);
+        for (SoftBody *sb : bodies)
+            delete sb;
+        return hash;
+    };
+
+    bool ok = true;
+    for (uint deterministic = 0; deterministic < 2; deterministic++)
+    {
+        vector<uint64_t> hashes;
+        for (uint thread_count : {1, 2, 3, 4, 8})
+            hashes.push_back(run(thread_count, deterministic));
+        bool same = count(hashes.begin(), hashes.end(), hashes[0]) == (long)hashes.size();
+        if (deterministic)
+            ok = ok && same;
+        cout << (deterministic ? "deterministic" : "non-deterministic") << " on 1, 2, 3, 4 and 8 threads"
+             << " distinct states: " << set<uint64_t>(hashes.begin(), hashes.end()).size()
+             << " hash: " << hex << hashes[0] << dec
+             << (deterministic ? (same ? " ok" : " FAILED") : "") << endl;
+    }
+
+    // both modes step their own lattice, warmed up and then timed in turns, the best round of each counts
+    uint max_threads = max(thread::hardware_concurrency(), 2u);
+    uint round_steps = steps / 20 + 1;
+    for (uint thread_count : {1u, max_threads})
+    {
+        SoftBody *bodies[2];
+        Simulator sims[2] = {Simulator(0, 0.5), Simulator(0, 0.5)};
+        double results[2] = {0, 0};
+        for (uint deterministic = 0; deterministic < 2; deterministic++)
+        {
+            SoftBody *sb = make_lattice(w, h, 0.01, 0.01, 500, 0.1);
+            sb->set_integration_method(INTEGRATE_IMPLICIT);
+            sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * 0.01});
+            Simulator &s = sims[deterministic];
+            s.set_thread_count(thread_count);
+            s.set_deterministic(deterministic);
+            s.dsp_w_m = w * 0.01 + 1;
+            s.dsp_h_m = h * 0.01 + 1;
+            s.add_body(sb);
+            bodies[deterministic] = sb;
+            for (uint i = 0; i < 3; i++)
+                s.simulate_next_frame(0.001);
+        }
+        for (uint round = 0; round < 3; round++)
+            for (uint deterministic = 0; deterministic < 2; deterministic++)
+            {
+                auto start = chrono::steady_clock::now();
+                for (uint i = 0; i < round_steps; i++)
+                    sims[deterministic].simulate_next_frame(0.001);
+                double steps_per_s = round_steps / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                results[deterministic] = max(results[deterministic], steps_per_s);
+            }
+        cout << "implicit lattice " << w << "x" << h << " threads: " << thread_count
+             << " steps/s deterministic: " << results[1]
+             << " non-deterministic: " << results[0]
+             << " cost: " << (1 - results[1] / results[0]) * 100 << "%" << endl;
+        delete bodies[0];
+        delete bodies[1];
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    uint steps = argc > 1 ? atoi(argv[1]) : 200;
+
+    if (!check_spring_kernels(100, 100, steps))
+        return 1;
+    if (!check_checkpoint(steps * 2, 1000000))
+        return 1;
+    if (!check_replay(steps * 2))
+        return 1;
+    if (!check_determinism(steps, 300, 300))
+        return 1;
+    if (!check_frame_allocations(50, 500))
+        return 1;
+    if (!check_spans(steps, 160, 160))
+        return 1;
+    if (!check_draw_list(50, 50, 20) || !check_draw_list(160, 160, 20))
+        return 1;
+
+    bench_implicit_vs_explicit(1);
+    bench_xpbd(1);
+    bench_adaptive(2, 1e-4);
+    bench_sleeping(400, steps * 5);
+    bench_mesh_construction(1000000);
+    bench_recorder(300, 300, steps);
+    bench_profiler(400, steps, max(thread::hardware_concurrency(), 2u));
+    bench_lattice_steps(10, 10, steps * 10);
+    bench_lattice_steps(100, 100, steps);
+
+    // thread scaling, 1, 2, 4, ... up to the number of hardware threads
+    uint max_threads = max(thread::hardware_concurrency(), 1u);
+    for (uint t = 1;; t *= 2)
+    {
+        t = min(t, max_threads);
+        bench_lattice_steps(300, 300, max(steps / 10, 1u), t);
+        bench_many_bodies(200, max(steps / 5, 1u), t);
+        bench_colliding_bodies(4000, max(steps / 4, 1u), t);
+        if (t == max_threads)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include <bits/stdc++.h>
+#include "../softbody/softbody.h"
+#include "../softbody/meshes.h"
+
+#ifndef BENCH_LATTICE_CPP_
+#define BENCH_LATTICE_CPP_
+
+using namespace std;
+
+// Builds a w x h lattice of nodes with structural and shear springs.
+SoftBody *make_lattice(uint w, uint h, double spacing, double mass, double spring_coef, double damping_coef)
+{
+    SoftBody *sb = new SoftBody();
+    meshes::build_grid(sb, {0.5, 0.5}, w, h, spacing, mass, spring_coef, damping_coef, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+    return sb;
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <bits/stdc++.h>
+// counts the heap allocations of a benchmark's steps
+#define COUNT_ALLOCATIONS
+#include "../utils/allocation_counter.cpp"
+#include "../softbody/softbody.h"
+#include "../softbody/meshes.h"
+#include "../simulator.h"
+#include "lattice.cpp"
+
+using namespace std;
+
+// Microbenchmarks of body construction and of the physics hot paths on lattices from 10 nodes up to a million,
+// printed as JSON so runs of different commits can be diffed. Every benchmark repeats a step over the whole mesh,
+// an op is one edge or node for the per element benchmarks and one step for the others.
+
+struct bench_result
+{
+    string name;
+    uint nodes;
+    uint edges;
+    uint64_t steps;
+    uint64_t ops_per_step;
+    double ns_per_op;
+    double nodes_per_s;
+    double allocations_per_step;
+};
+
+// Runs step once to warm up, then repeats it until min_time_s has passed.
+template <typename _F>
+bench_result run_bench(const string &name, SoftBody *sb, uint64_t ops_per_step, double min_time_s, const _F &step)
+{
+    step();
+
+    uint64_t steps = 0;
+    uint64_t allocations_before = utils::allocation_count().load();
+    auto start = chrono::steady_clock::now();
+    double elapsed_s = 0;
+    do
+    {
+        step();
+        steps++;
+        elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed_s < min_time_s);
+    uint64_t allocations = utils::allocation_count().load() - allocations_before;
+
+    bench_result r;
+    r.name = name;
+    r.nodes = sb->get_nodes()->size();
+    r.edges = sb->get_edges()->size();
+    r.steps = steps;
+    r.ops_per_step = ops_per_step;
+    r.ns_per_op = elapsed_s * 1e9 / (steps * ops_per_step);
+    r.nodes_per_s = steps * r.nodes / elapsed_s;
+    r.allocations_per_step = (double)allocations / steps;
+    return r;
+}
+
+// runs every benchmark on a lattice of about node_count nodes
+void bench_mesh(uint node_count, double min_time_s, vector<bench_result> *out)
+{
+    double mass = 0.01;
+    uint w = ceil(sqrt(node_count));
+    uint h = (node_count + w - 1) / w;
+    SoftBody *sb = make_lattice(w, h, 0.02, mass, 500, 0.1);
+    sb->set_external_force(FORCE_GRAVITY, {0, 9.81 * mass});
+    NodeStore *nodes = sb->get_nodes();
+    uint edge_count = sb->get_edges()->size();
+    // well under the stability limit of the lattice
+    double dt = 1e-4;
+
+    // keeps the results of the edge functions alive
+    double sink = 0;
+    out->push_back(run_bench("edge_calculate_spring_force", sb, edge_count, min_time_s, [&]() {
+        for (uint i = 0; i < edge_count; i++)
+            sink += sb->get_edge(i).calculate_spring_force().first[0];
+    }));
+    out->push_back(run_bench("edge_calculate_damping_vectors", sb, edge_count, min_time_s, [&]() {
+        for (uint i = 0; i < edge_count; i++)
+            sink += sb->get_edge(i).calculate_damping_vectors().first[0];
+    }));
+    out->push_back(run_bench("node_update_state", sb, nodes->size(), min_time_s, [&]() {
+        nodes->update_state(dt, sb->get_external_force_sum());
+    }));
+    out->push_back(run_bench("softbody_advance_physics", sb, 1, min_time_s, [&]() {
+        sb->advance_physics(dt);
+    }));
+
+    Simulator s = Simulator(0, 0.5);
+    s.dsp_w_m = w * 0.02 + 1;
+    s.dsp_h_m = h * 0.02 + 1;
+    s.add_body(sb);
+    out->push_back(run_bench("simulator_handle_wall_collisions", sb, 1, min_time_s, [&]() {
+        s.handle_wall_collisions(sb);
+    }));
+    out->push_back(run_bench("simulator_simulate_next_frame", sb, 1, min_time_s, [&]() {
+        s.simulate_next_frame(dt);
+    }));
+
+    if (sink == 12345)
+        cerr << sink << endl;
+    delete sb;
+}
+
+// Builds a body of about edge_count edges with structural and shear springs, once node by node and edge by edge
+// after reserving the storage and once with meshes::build_grid. An op is one edge.
+void bench_construction(uint edge_count, double min_time_s, vector<bench_result> *out)
+{
+    // about 4 edges per node
+    uint side = max((uint)ceil(sqrt(edge_count / 4.)), 2u);
+    uint grid_edges = 2 * side * (side - 1) + 2 * (side - 1) * (side - 1);
+    SoftBody built;
+
+    out->push_back(run_bench("softbody_add_edge_construction", &built, grid_edges, min_time_s, [&]() {
+        built = SoftBody();
+        built.reserve(side * side, grid_edges);
+        for (uint y = 0; y < side; y++)
+            for (uint x = 0; x < side; x++)
+                built.add_node({x * 0.02, y * 0.02}, 0.01);
+        for (uint y = 0; y < side; y++)
+            for (uint x = 0; x < side; x++)
+            {
+                uint n = y * side + x;
+                if (x + 1 < side)
+                    built.add_edge(n, n + 1, 500, 0.1);
+                if (y + 1 < side)
+                    built.add_edge(n, n + side, 500, 0.1);
+                if (x + 1 < side && y + 1 < side)
+                {
+                    built.add_edge(n, n + side + 1, 500, 0.1);
+                    built.add_edge(n + 1, n + side, 500, 0.1);
+                }
+            }
+    }));
+    out->push_back(run_bench("meshes_build_grid_construction", &built, grid_edges, min_time_s, [&]() {
+        built = SoftBody();
+        meshes::build_grid(&built, {}, side, side, 0.02, 0.01, 500, 0.1, meshes::GRID_STRUCTURAL | meshes::GRID_SHEAR);
+    }));
+}
+
+void print_json(const vector<bench_result> &results)
+{
+    cout << "{\n  \"benchmarks\": [\n";
+    for (uint i = 0; i < results.size(); i++)
+    {
+        const bench_result &r = results[i];
+        cout << "    {\"name\": \"" << r.name << "\""
+             << ", \"nodes\": " << r.nodes
+             << ", \"edges\": " << r.edges
+             << ", \"steps\": " << r.steps
+             << ", \"ops_per_step\": " << r.ops_per_step
+             << ", \"ns_per_op\": " << r.ns_per_op
+             << ", \"nodes_per_s\": " << r.nodes_per_s
+             << ", \"allocations_per_step\": " << r.allocations_per_step
+             << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    cout << "  ]\n}" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    uint max_nodes = argc > 1 ? atoi(argv[1]) : 1000000;
+    double min_time_s = argc > 2 ? atof(argv[2]) : 0.2;
+
+    vector<bench_result> results;
+    bench_construction(1000000, min_time_s, &results);
+    for (uint n = 10; n <= max_nodes; n *= 10)
+    {
+        bench_mesh(n, min_time_s, &results);
+        if (n > numeric_limits<uint>::max() / 10)
+            break;
+    }
+    cout << setprecision(6);
+    print_json(results);
+    return 0;
+}
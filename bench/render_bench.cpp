@@ -0,0 +1,84 @@
+#include <bits/stdc++.h>
+#include "../softbody/softbody.h"
+#include "../simulator.h"
+#include "../ui/cairo_renderer.h"
+#include "lattice.cpp"
+
+using namespace std;
+
+// Renders lattices of about 10k and 100k edges offscreen into a Cairo image surface and prints the ms per frame,
+// once drawing every edge and node as its own primitive and once through the batched add_lines and add_circles.
+// Needs Cairo and libX11 but no display, GLFW or SDL.
+
+double frame_ms(CairoRenderer *renderer, Simulator *s, double edge_w, double node_r, bool batched, uint frames)
+{
+    DrawList::style_t edge_style = {{93, 196, 255, 1}, edge_w};
+    DrawList::style_t node_style = {{245, 253, 255, 1}, 0};
+    auto start = chrono::steady_clock::now();
+    for (uint f = 0; f < frames; f++)
+    {
+        utils::span<vec_t> positions = s->get_positions();
+        utils::span<uint> edge_nodes = s->get_edge_nodes();
+        renderer->begin();
+        renderer->add_rectangle({0, 0}, s->dsp_w_m, s->dsp_h_m, {1, 16, 89, 1});
+        if (batched)
+        {
+            renderer->add_lines(positions, edge_nodes, edge_style);
+            renderer->add_circles(positions, node_r, node_style);
+        }
+        else
+        {
+            for (size_t e = 0; e < edge_nodes.size(); e += 2)
+                renderer->add_line(positions[edge_nodes[e]], positions[edge_nodes[e + 1]], edge_w, edge_style.color);
+            for (const vec_t &position : positions)
+                renderer->add_circle(position, node_r, node_style.color);
+        }
+        renderer->render();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000 / frames;
+}
+
+// png_path, if not empty, gets the last batched frame
+void bench_render(uint w, uint h, uint frames, const string &png_path)
+{
+    double spacing = 0.8 / max(w, h);
+    SoftBody *sb = make_lattice(w, h, spacing, 0.01, 500, 0.1);
+    sb->move_relative({-0.4, -0.4});
+    Simulator s = Simulator(0, 0.5);
+    s.dsp_w_m = 1;
+    s.dsp_h_m = 1;
+    s.add_body(sb);
+    s.simulate_next_frame(0.0005);
+
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, WIDTH, HEIGHT);
+    CairoRenderer renderer(s.dsp_w_m, s.dsp_h_m, surface);
+    double edge_w = spacing / 10, node_r = spacing / 4;
+    // first frames warm up the surface and the draw list
+    frame_ms(&renderer, &s, edge_w, node_r, false, 1);
+    double single_ms = frame_ms(&renderer, &s, edge_w, node_r, false, frames);
+    frame_ms(&renderer, &s, edge_w, node_r, true, 1);
+    double batched_ms = frame_ms(&renderer, &s, edge_w, node_r, true, frames);
+    if (!png_path.empty())
+        cairo_surface_write_to_png(surface, png_path.c_str());
+
+    cout << "render lattice " << w << "x" << h
+         << " edges: " << sb->get_edges()->size()
+         << " nodes: " << sb->get_nodes()->size()
+         << " ms/frame single: " << single_ms
+         << " batched: " << batched_ms
+         << " speedup: " << single_ms / batched_ms << endl;
+    renderer.quit();
+    cairo_surface_destroy(surface);
+    delete sb;
+}
+
+int main(int argc, char **argv)
+{
+    uint frames = argc > 1 ? atoi(argv[1]) : 20;
+    string png_path = argc > 2 ? argv[2] : "";
+
+    // 9702 and 101442 edges
+    bench_render(50, 50, frames, png_path);
+    bench_render(160, 160, frames, png_path);
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <bits/stdc++.h>
+#include "softbody/softbody.h"
+#include "simulator.h"
+#include "recorder.h"
+#include "scene.cpp"
+
+using namespace std;
+
+// Runs the demo scene without a renderer and prints the throughput, for machines without a display.
+
+void usage()
+{
+    cout << "Required arguments: \n"
+         << "    <spring> <damping> <friction> <time step> <steps, or simulated seconds with an s suffix> [threads] [integrator: 0 explicit, 1 implicit, 2 xpbd] [adaptive tolerance] [bodies] [state dump file] [checkpoint file] [checkpoint every n steps] [recording file] [profile trace file]\n"
+         << "An existing checkpoint file is restored instead of building the scene, the checkpoint is saved again every n steps\n"
+         << "(0 only at the end). A file of - leaves that output off, so each can be enabled on its own.\n"
+         << "The recording gets the node positions of every step.\n"
+         << "With a trace file the phases are timed, their summary is printed and their trace written at the end." << endl;
+    exit(1);
+}
+
+// Writes the nodes and edges of every body as text, one body after the other:
+//     body <index> <node count> <edge count>
+//     <position> <velocity>               for every node
+//     <node1> <node2> <rest length> <deformation>   for every edge
+void dump_state(const string &path, Simulator *s)
+{
+    ofstream out(path);
+    if (!out)
+    {
+        cout << "can't open " << path << endl;
+        exit(1);
+    }
+    out << setprecision(17);
+    for (uint b = 0; b < s->get_body_count(); b++)
+    {
+        NodeStore *nodes = s->get_body(b)->get_nodes();
+        EdgeTable *edges = s->get_body(b)->get_edges();
+        out << "body " << b << " " << nodes->size() << " " << edges->size() << "\n";
+        for (uint i = 0; i < nodes->size(); i++)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+                out << nodes->position[d][i] << " ";
+            for (uint d = 0; d < DIMENSIONS; d++)
+                out << nodes->velocity[d][i] << (d + 1 < DIMENSIONS ? " " : "\n");
+        }
+        for (uint e = 0; e < edges->size(); e++)
+            out << edges->node1[e] << " " << edges->node2[e] << " " << edges->rest_length[e] << " " << edges->deformation[e] << "\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 6)
+        usage();
+
+    double spring_coef = atof(argv[1]);
+    double damping_coef = atof(argv[2]);
+    double friction_coef = atof(argv[3]);
+    double time_step = atof(argv[4]);
+    string length = argv[5];
+    uint thread_count = argc > 6 ? atoi(argv[6]) : 1;
+    integration_method method = argc > 7 ? (integration_method)atoi(argv[7]) : INTEGRATE_EXPLICIT;
+    double adaptive_tolerance = argc > 8 ? atof(argv[8]) : 0;
+    uint body_count = argc > 9 ? max(atoi(argv[9]), 1) : 1;
+    string dump_path = argc > 10 && string(argv[10]) != "-" ? argv[10] : "";
+    string checkpoint_path = argc > 11 && string(argv[11]) != "-" ? argv[11] : "";
+    uint64_t checkpoint_every = argc > 12 ? atoll(argv[12]) : 0;
+    string recording_path = argc > 13 && string(argv[13]) != "-" ? argv[13] : "";
+    string trace_path = argc > 14 && string(argv[14]) != "-" ? argv[14] : "";
+    if (time_step <= 0)
+        usage();
+
+    double time_step_s = time_step / 1000;
+    uint64_t steps;
+    if (!length.empty() && length.back() == 's')
+        steps = llround(atof(length.c_str()) / time_step_s);
+    else
+        steps = atoll(length.c_str());
+
+    // copies of the demo body side by side, the demo body spans 1.8 by 0.6 meters
+    vector<SoftBody> bodies(body_count, SoftBody(2, 1, 0.5));
+    uint per_row = ceil(sqrt(body_count));
+    Simulator s = Simulator(0, friction_coef);
+    s.dsp_w_m = max(s.dsp_w_m, per_row * 2.2 + 2);
+    s.dsp_h_m = max(s.dsp_h_m, (body_count + per_row - 1) / per_row * 1. + 2);
+    s.set_thread_count(thread_count);
+    if (adaptive_tolerance > 0)
+        s.set_adaptive_stepping(true, adaptive_tolerance, time_step_s / 100, time_step_s);
+
+    uint64_t node_count = 0;
+    for (uint i = 0; i < body_count; i++)
+    {
+        bodies[i].set_integration_method(method);
+        build_scene(&bodies[i], spring_coef, damping_coef);
+        bodies[i].move_relative({(i % per_row) * 2.2, (i / per_row) * 1.});
+        node_count += bodies[i].get_nodes()->size();
+    }
+    for (SoftBody &sb : bodies)
+        s.add_body(&sb);
+
+    // the checkpoint replaces the scene, its walls, bodies and settings
+    if (!checkpoint_path.empty() && filesystem::exists(checkpoint_path))
+    {
+        if (!s.restore_checkpoint(checkpoint_path))
+        {
+            cout << "can't restore " << checkpoint_path << endl;
+            exit(1);
+        }
+        body_count = s.get_body_count();
+        node_count = 0;
+        for (uint i = 0; i < body_count; i++)
+            node_count += s.get_body(i)->get_nodes()->size();
+        cout << "restored " << checkpoint_path << endl;
+    }
+    auto save_checkpoint = [&]() {
+        if (!s.save_checkpoint(checkpoint_path))
+        {
+            cout << "can't save " << checkpoint_path << endl;
+            exit(1);
+        }
+    };
+
+    unique_ptr<TrajectoryRecorder> recorder;
+    if (!recording_path.empty())
+    {
+        recorder.reset(new TrajectoryRecorder(recording_path));
+        s.set_frame_listener(recorder.get());
+    }
+
+    utils::Profiler::set_enabled(!trace_path.empty());
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < steps; i++)
+    {
+        s.simulate_next_frame(time_step_s);
+        if (!checkpoint_path.empty() && checkpoint_every > 0 && (i + 1) % checkpoint_every == 0)
+            save_checkpoint();
+    }
+    double elapsed_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    utils::Profiler::set_enabled(false);
+
+    cout << "bodies: " << body_count
+         << " nodes: " << node_count
+         << " threads: " << thread_count
+         << " steps: " << steps
+         << " simulated s: " << steps * time_step_s
+         << " wall s: " << elapsed_s
+         << " steps/s: " << steps / elapsed_s
+         << " node updates/s: " << steps * node_count / elapsed_s;
+    if (adaptive_tolerance > 0)
+        cout << " rejected steps: " << s.get_rejected_steps();
+    cout << endl;
+
+    if (recorder)
+    {
+        s.set_frame_listener(NULL);
+        if (!recorder->close())
+        {
+            cout << "can't write " << recording_path << endl;
+            exit(1);
+        }
+        cout << "recorded frames: " << recorder->get_recorded_frames()
+             << " dropped: " << recorder->get_dropped_frames()
+             << " bytes: " << recorder->get_bytes_written() << endl;
+    }
+
+    if (!trace_path.empty())
+    {
+        utils::Profiler::print_summary(cout);
+        if (!utils::Profiler::write_chrome_trace(trace_path))
+        {
+            cout << "can't write " << trace_path << endl;
+            exit(1);
+        }
+    }
+
+    if (!checkpoint_path.empty())
+        save_checkpoint();
+    if (!dump_path.empty())
+        dump_state(dump_path, &s);
+    return 0;
+}
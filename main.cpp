@@ -1,6 +1,10 @@
 #include <bits/stdc++.h>
+// built with make DEBUG_FLAGS=-DCOUNT_ALLOCATIONS, counts the heap allocations of a frame, see Ui::report_run_stats
+#include "utils/allocation_counter.cpp"
 #include "softbody/softbody.h"
 #include "simulator.h"
+#include "recorder.h"
+#include "scene.cpp"
 #include "ui/ui.cpp"
 
 using namespace std;
@@ -8,7 +12,10 @@ using namespace std;
 vector<double> p_args(int argc, char **argv) {
     if (argc < 7) {
         cout << "Required arguments: \n"
-             << "    <spring> <damping> <friction> <time step> <time scale> <frame rate>" << endl;
+             << "    <spring> <damping> <friction> <time step> <time scale> <frame rate> [threads] [integrator: 0 explicit, 1 implicit, 2 xpbd] [adaptive tolerance] [unthrottled] [recording file] [profile trace file] [sleep]\n"
+             << "With sleep 1 the body falls asleep after resting for a simulated second, pulling it wakes it.\n"
+             << "A file of - leaves that output off, so each can be enabled on its own.\n"
+             << "With a trace file the phases are timed, p prints their summary and the trace is written on quitting." << endl;
         exit(1);
     }
 
@@ -28,54 +35,49 @@ int main(int argc, char **argv)
     double time_step = args[3];
     double time_scale = args[4];
     uint frame_rate = args[5];
+    uint thread_count = args.size() > 6 ? args[6] : 1;
+    integration_method method = args.size() > 7 ? (integration_method)args[7] : INTEGRATE_EXPLICIT;
+    double adaptive_tolerance = args.size() > 8 ? args[8] : 0;
+    bool unthrottled = args.size() > 9 && args[9] != 0;
+    string recording_path = argc > 11 && string(argv[11]) != "-" ? argv[11] : "";
+    string trace_path = argc > 12 && string(argv[12]) != "-" ? argv[12] : "";
+    bool sleeping = args.size() > 12 && args[12] != 0;
+    utils::Profiler::set_enabled(!trace_path.empty());
 
-    vector<Node> node_v = {
-        Node({1, 0.1}, 0.2),
-        Node({1.6, 0.1}, 0.2),
-        Node({2.2, 0.1}, 0.2),
-        Node({2.8, 0.1}, 0.2),
-        Node({1, 0.7}, 0.2),
-        Node({1.6, 0.7}, 0.2),
-        Node({2.2, 0.7}, 0.2),
-        Node({2.8, 0.7}, 0.2),
-    };
-    cout << "hello" << endl;
-
-    list<Edge> edge_l = {
-        Edge(&node_v[0], &node_v[1], spring_coef, damping_coef),
-        Edge(&node_v[1], &node_v[2], spring_coef, damping_coef),
-        Edge(&node_v[2], &node_v[3], spring_coef, damping_coef),
-        Edge(&node_v[3], &node_v[7], spring_coef, damping_coef),
-        Edge(&node_v[7], &node_v[6], spring_coef, damping_coef),
-        Edge(&node_v[6], &node_v[5], spring_coef, damping_coef),
-        Edge(&node_v[5], &node_v[4], spring_coef, damping_coef),
-        Edge(&node_v[4], &node_v[0], spring_coef, damping_coef),
-
-        Edge(&node_v[0], &node_v[5], spring_coef, damping_coef),
-        Edge(&node_v[1], &node_v[4], spring_coef, damping_coef),
-        Edge(&node_v[1], &node_v[6], spring_coef, damping_coef),
-        Edge(&node_v[2], &node_v[5], spring_coef, damping_coef),
-        Edge(&node_v[2], &node_v[7], spring_coef, damping_coef),
-        Edge(&node_v[3], &node_v[6], spring_coef, damping_coef),
+    SoftBody sb = SoftBody(2, 1, 0.5);
+    sb.set_integration_method(method);
 
-        Edge(&node_v[1], &node_v[5], spring_coef, damping_coef),
-        Edge(&node_v[2], &node_v[6], spring_coef, damping_coef)};
+    build_scene(&sb, spring_coef, damping_coef);
+    cout << "hello" << endl;
 
     ios_base::sync_with_stdio(true);
 
-    SoftBody sb = SoftBody(&node_v, &edge_l, 2, 1, 0.5);
-    SoftBody sb2 = SoftBody(node_v, edge_l);
-
-    //sb.add_velocity({0, 0});
-    //sb.move_relative({1, 4.3});
-    sb.move_relative({1, 1.3});
-    vector<double> g = {0, 9.81 * node_v[0].get_mass()};
-    sb.set_external_force("gravity", g);
-
     Simulator s = Simulator(0, friction_coef);
+    s.set_thread_count(thread_count);
+    // every time step is covered by adaptive steps no larger than it
+    if (adaptive_tolerance > 0)
+        s.set_adaptive_stepping(true, adaptive_tolerance, time_step / 1000 / 100, time_step / 1000);
+    // the body sleeps after resting for a simulated second, pulling it wakes it
+    if (sleeping)
+        s.set_sleeping(true, 1e-3, max(1000 / time_step, 1.));
     s.add_body(&sb);
 
+    // node positions of every step, written in the background
+    unique_ptr<TrajectoryRecorder> recorder;
+    if (!recording_path.empty())
+    {
+        recorder.reset(new TrajectoryRecorder(recording_path));
+        s.set_frame_listener(recorder.get());
+    }
+
     Ui<CairoRenderer> u = Ui<CairoRenderer>(&s, time_scale);
-    u.simulation_auto_run(time_step, frame_rate);
+    u.simulation_auto_run(time_step, frame_rate, unthrottled);
+    s.set_frame_listener(NULL);
+    if (!trace_path.empty())
+    {
+        utils::Profiler::print_summary(cout);
+        if (!utils::Profiler::write_chrome_trace(trace_path))
+            cout << "can't write " << trace_path << endl;
+    }
     return 0;
 }
@@ -0,0 +1,289 @@
+#include <bits/stdc++.h>
+#include <zlib.h>
+#include "simulator.h"
+#include "recorder.h"
+
+#ifndef RECORDER_CPP_
+#define RECORDER_CPP_
+
+using namespace std;
+
+static inline void put_varint(vector<uint8_t> *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out->push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((uint8_t)value);
+}
+
+// small magnitudes of either sign get small codes
+static inline uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const string &path, double quantum, size_t ring_bytes, uint frames_per_chunk)
+{
+    this->quantum = quantum;
+    this->frames_per_chunk = max(frames_per_chunk, 1u);
+    this->ring_bytes = ring_bytes;
+    // the ring is sized and its slots allocated on the first frame, once the scene size is known
+
+    this->file = fopen(path.c_str(), "wb");
+    this->ok = this->file != NULL;
+    trajectory_header_t header = {TRAJECTORY_MAGIC, TRAJECTORY_VERSION, DIMENSIONS, this->frames_per_chunk, quantum};
+    write_bytes(&header, sizeof(header));
+
+    this->writer = thread(&TrajectoryRecorder::write_loop, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    close();
+}
+
+// Copies the positions into the next slot of the ring, the slot only grows when a body got more nodes or edges.
+void TrajectoryRecorder::on_frame(Simulator *s, double time_step_s)
+{
+    uint64_t frame = this->next_frame++;
+    this->time += time_step_s;
+
+    uint body_count = s->get_body_count();
+    size_t node_count = 0;
+    for (uint b = 0; b < body_count; b++)
+        node_count += s->get_body(b)->get_nodes()->size();
+    if (this->ring_frames == 0)
+    {
+        size_t edge_count = 0;
+        for (uint b = 0; b < body_count; b++)
+            edge_count += s->get_body(b)->get_edges()->size();
+        size_t frame_bytes = node_count * DIMENSIONS * sizeof(double) + edge_count * 2 * sizeof(uint) +
+                             body_count * (2 * sizeof(uint) + sizeof(uint8_t)) + sizeof(frame_slot_t);
+        this->ring_frames = min(max(this->ring_bytes / frame_bytes, (size_t)2), (size_t)TRAJECTORY_MAX_RING_FRAMES);
+        // every slot can hold a full frame, so the steps after this one only copy
+        this->slots.resize(this->ring_frames);
+        for (frame_slot_t &slot : this->slots)
+        {
+            slot.body_nodes.reserve(body_count);
+            slot.positions.reserve(node_count * DIMENSIONS);
+            slot.edges_changed.reserve(body_count);
+            slot.edge_counts.reserve(body_count);
+            slot.edge_nodes.reserve(edge_count * 2);
+        }
+    }
+
+    uint64_t produced = this->produced.load(memory_order_relaxed);
+    if (this->closing.load(memory_order_relaxed) || produced - this->consumed.load(memory_order_acquire) == this->ring_frames)
+    {
+        this->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    frame_slot_t &slot = this->slots[produced % this->ring_frames];
+    slot.frame = frame;
+    slot.time = this->time;
+    slot.walls[0] = s->dsp_w_m;
+    slot.walls[1] = s->dsp_h_m;
+    slot.body_nodes.resize(body_count);
+    for (uint b = 0; b < body_count; b++)
+        slot.body_nodes[b] = s->get_body(b)->get_nodes()->size();
+    slot.positions.resize(node_count * DIMENSIONS);
+
+    // the edges of a body are only written again when its table or the table's version changed
+    this->last_tables.resize(body_count, NULL);
+    this->last_edge_versions.resize(body_count, 0);
+    slot.edges_changed.resize(body_count);
+    slot.edge_counts.resize(body_count);
+    slot.edge_nodes.clear();
+    for (uint b = 0; b < body_count; b++)
+    {
+        EdgeTable *edges = s->get_body(b)->get_edges();
+        slot.edges_changed[b] = edges != this->last_tables[b] || edges->version != this->last_edge_versions[b];
+        slot.edge_counts[b] = edges->size();
+        this->last_tables[b] = edges;
+        this->last_edge_versions[b] = edges->version;
+        if (!slot.edges_changed[b])
+            continue;
+        for (uint e = 0; e < edges->size(); e++)
+        {
+            slot.edge_nodes.push_back(edges->node1[e]);
+            slot.edge_nodes.push_back(edges->node2[e]);
+        }
+    }
+
+    double *out = slot.positions.data();
+    for (uint b = 0; b < body_count; b++)
+    {
+        NodeStore *nodes = s->get_body(b)->get_nodes();
+        for (uint d = 0; d < DIMENSIONS; d++)
+        {
+            memcpy(out, nodes->position[d].data(), slot.body_nodes[b] * sizeof(double));
+            out += slot.body_nodes[b];
+        }
+    }
+
+    this->produced.store(produced + 1);
+    // the writer announces itself before it checks produced, so it either sees this frame or gets woken,
+    // the lock is only taken when it's asleep
+    if (this->writer_waiting.load())
+    {
+        lock_guard<mutex> l(this->lock);
+        this->ready.notify_one();
+    }
+}
+
+void TrajectoryRecorder::write_bytes(const void *data, size_t size)
+{
+    if (this->ok && fwrite(data, 1, size, this->file) != size)
+        this->ok = false;
+    this->file_offset += size;
+}
+
+void TrajectoryRecorder::write_loop()
+{
+    while (true)
+    {
+        uint64_t consumed = this->consumed.load(memory_order_relaxed);
+        if (consumed == this->produced.load(memory_order_acquire))
+        {
+            if (this->closing.load())
+                break;
+            unique_lock<mutex> l(this->lock);
+            this->writer_waiting.store(true);
+            this->ready.wait(l, [this, consumed] { return consumed != this->produced.load() || this->closing.load(); });
+            this->writer_waiting.store(false);
+            continue;
+        }
+
+        // ring_frames was set before the first frame was published
+        encode(this->slots[consumed % this->ring_frames]);
+        this->consumed.store(consumed + 1, memory_order_release);
+    }
+
+    flush_chunk();
+    uint64_t index_offset = this->file_offset;
+    if (!this->index.empty())
+        write_bytes(this->index.data(), this->index.size() * sizeof(trajectory_index_entry_t));
+    trajectory_footer_t footer = {index_offset, (uint32_t)this->index.size(), TRAJECTORY_INDEX_MAGIC};
+    write_bytes(&footer, sizeof(footer));
+}
+
+void TrajectoryRecorder::encode(const frame_slot_t &slot)
+{
+    if (this->chunk_frames == 0)
+    {
+        this->chunk_first_frame = slot.frame;
+        this->chunk_first_time = slot.time;
+    }
+    bool reset = this->chunk_frames == 0 || slot.body_nodes != this->previous_body_nodes;
+    if (reset)
+    {
+        this->previous.assign(slot.positions.size(), 0);
+        this->previous_body_nodes = slot.body_nodes;
+    }
+
+    put_varint(&this->raw, slot.frame);
+    const uint8_t *doubles = (const uint8_t *)&slot.time;
+    this->raw.insert(this->raw.end(), doubles, doubles + sizeof(double));
+    doubles = (const uint8_t *)slot.walls;
+    this->raw.insert(this->raw.end(), doubles, doubles + sizeof(slot.walls));
+    put_varint(&this->raw, slot.body_nodes.size());
+    for (uint n : slot.body_nodes)
+        put_varint(&this->raw, n);
+
+    this->edges.resize(slot.body_nodes.size());
+    const uint *edge_nodes = slot.edge_nodes.data();
+    for (uint b = 0; b < slot.body_nodes.size(); b++)
+    {
+        if (slot.edges_changed[b])
+        {
+            this->edges[b].assign(edge_nodes, edge_nodes + 2 * slot.edge_counts[b]);
+            edge_nodes += 2 * slot.edge_counts[b];
+        }
+        if (!reset && !slot.edges_changed[b])
+        {
+            put_varint(&this->raw, 0);
+            continue;
+        }
+        // edges of a mesh are built in order, their first nodes barely change and their second nodes are near them
+        put_varint(&this->raw, this->edges[b].size() / 2 + 1);
+        int64_t node1 = 0;
+        for (uint e = 0; e < this->edges[b].size(); e += 2)
+        {
+            put_varint(&this->raw, zigzag((int64_t)this->edges[b][e] - node1));
+            put_varint(&this->raw, zigzag((int64_t)this->edges[b][e + 1] - this->edges[b][e]));
+            node1 = this->edges[b][e];
+        }
+    }
+
+    double inv_quantum = 1 / this->quantum;
+    int64_t *previous = this->previous.data();
+    for (size_t i = 0; i < slot.positions.size(); i++)
+    {
+        int64_t q = llround(slot.positions[i] * inv_quantum);
+        put_varint(&this->raw, zigzag(q - previous[i]));
+        previous[i] = q;
+    }
+
+    if (++this->chunk_frames == this->frames_per_chunk || this->raw.size() >= TRAJECTORY_MAX_CHUNK_BYTES)
+        flush_chunk();
+}
+
+void TrajectoryRecorder::flush_chunk()
+{
+    if (this->chunk_frames == 0)
+        return;
+
+    uLongf compressed_size = compressBound(this->raw.size());
+    this->compressed.resize(compressed_size);
+    if (compress2(this->compressed.data(), &compressed_size, this->raw.data(), this->raw.size(), Z_BEST_SPEED) != Z_OK)
+        this->ok = false;
+
+    trajectory_chunk_t chunk = {TRAJECTORY_CHUNK_MAGIC, this->chunk_frames, this->chunk_first_frame, this->chunk_first_time,
+                                (uint32_t)this->raw.size(), (uint32_t)compressed_size};
+    this->index.push_back({this->chunk_first_frame, this->chunk_first_time, this->file_offset});
+    write_bytes(&chunk, sizeof(chunk));
+    write_bytes(this->compressed.data(), compressed_size);
+    this->bytes_written.store(this->file_offset, memory_order_relaxed);
+
+    this->raw.clear();
+    this->chunk_frames = 0;
+}
+
+bool TrajectoryRecorder::close()
+{
+    if (this->closed)
+        return this->ok;
+    this->closed = true;
+    {
+        lock_guard<mutex> l(this->lock);
+        this->closing.store(true);
+        this->ready.notify_one();
+    }
+    this->writer.join();
+
+    if (this->file != NULL && fclose(this->file) != 0)
+        this->ok = false;
+    this->file = NULL;
+    this->bytes_written.store(this->file_offset, memory_order_relaxed);
+    return this->ok;
+}
+
+uint64_t TrajectoryRecorder::get_recorded_frames()
+{
+    return this->consumed.load(memory_order_relaxed);
+}
+
+uint64_t TrajectoryRecorder::get_dropped_frames()
+{
+    return this->dropped.load(memory_order_relaxed);
+}
+
+uint64_t TrajectoryRecorder::get_bytes_written()
+{
+    return this->bytes_written.load(memory_order_relaxed);
+}
+
+#endif
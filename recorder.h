@@ -0,0 +1,98 @@
+#include <bits/stdc++.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "simulator.h"
+#include "trajectory_format.h"
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+using namespace std;
+
+// Records the node positions and edges of every frame of a simulator to a file for offline analysis and replays,
+// see trajectory_format.h.
+//
+// on_frame copies the positions into the next free buffer of a ring and returns, a background thread encodes and
+// writes them. When the writer falls behind and the ring is full the frame is dropped and counted, the simulating
+// thread never waits for it. The edges of a body are copied again when its edge count changed.
+class TrajectoryRecorder : public _FrameListener
+{
+private:
+    struct frame_slot_t
+    {
+        uint64_t frame;
+        double time;
+        double walls[2];
+        vector<uint> body_nodes;
+        vector<double> positions;
+        // edges of the bodies whose edges changed, node index pairs one body after the other
+        vector<uint8_t> edges_changed;
+        vector<uint> edge_counts;
+        vector<uint> edge_nodes;
+    };
+
+    double quantum;
+    uint frames_per_chunk;
+
+    // simulating thread, edge table and edge count of every body in the last frame passed to the writer
+    uint64_t next_frame = 0;
+    double time = 0;
+    vector<EdgeTable *> last_tables;
+    vector<uint64_t> last_edge_versions;
+
+    // single producer, single consumer ring of ring_frames slots, produced and consumed count the frames through
+    // it. ring_frames is set from ring_bytes and the size of the first frame.
+    size_t ring_bytes;
+    uint ring_frames = 0;
+    vector<frame_slot_t> slots;
+    atomic<uint64_t> produced{0};
+    atomic<uint64_t> consumed{0};
+    atomic<uint64_t> dropped{0};
+
+    // writer thread
+    thread writer;
+    mutex lock;
+    condition_variable ready;
+    // set while the writer sleeps on ready, so the simulating thread only takes the lock to wake it
+    atomic<bool> writer_waiting{false};
+    atomic<bool> closing{false};
+    FILE *file = NULL;
+    bool ok = false;
+    bool closed = false;
+    uint64_t file_offset = 0;
+    atomic<uint64_t> bytes_written{0};
+    vector<int64_t> previous;
+    vector<uint> previous_body_nodes;
+    // node index pairs of the edges of every body
+    vector<vector<uint>> edges;
+    vector<uint8_t> raw;
+    vector<uint8_t> compressed;
+    uint chunk_frames = 0;
+    uint64_t chunk_first_frame = 0;
+    double chunk_first_time = 0;
+    vector<trajectory_index_entry_t> index;
+
+    void write_bytes(const void *data, size_t size);
+    void write_loop();
+    void encode(const frame_slot_t &slot);
+    void flush_chunk();
+
+public:
+    // about ring_bytes of frames wait for the writer, frames_per_chunk frames per compressed chunk
+    TrajectoryRecorder(const string &path, double quantum = 1e-6, size_t ring_bytes = 64 << 20, uint frames_per_chunk = 64);
+    // closes the file, detach the recorder from the simulator before
+    ~TrajectoryRecorder();
+
+    void on_frame(Simulator *s, double time_step_s) override;
+    // Writes the remaining frames and the index and waits for the writer. Returns false if the file couldn't be
+    // written, frames recorded after closing are dropped.
+    bool close();
+
+    // frames written, frames dropped because the ring was full and compressed bytes written so far
+    uint64_t get_recorded_frames();
+    uint64_t get_dropped_frames();
+    uint64_t get_bytes_written();
+};
+
+#endif
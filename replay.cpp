@@ -0,0 +1,38 @@
+#include <bits/stdc++.h>
+#include "trajectory_reader.h"
+#include "ui/replay.cpp"
+
+using namespace std;
+
+// Plays a file written by TrajectoryRecorder, no simulation runs.
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        cout << "Required arguments: \n"
+             << "    <recording file> [speed] [frame rate] [profile trace file]" << endl;
+        return 1;
+    }
+    double speed = argc > 2 ? atof(argv[2]) : 1;
+    uint frame_rate = argc > 3 ? atoi(argv[3]) : 60;
+    string trace_path = argc > 4 ? argv[4] : "";
+    utils::Profiler::set_enabled(!trace_path.empty());
+
+    TrajectoryReader reader(argv[1]);
+    if (!reader.good() || reader.get_frame_count() == 0)
+    {
+        cerr << "not a readable trajectory: " << argv[1] << endl;
+        return 1;
+    }
+    cout << "frames: " << reader.get_frame_count() << " seconds: " << reader.get_end_time() - reader.get_start_time() << endl;
+
+    Replay<CairoRenderer> r = Replay<CairoRenderer>(&reader, speed);
+    r.play(max(frame_rate, 1u));
+    if (!trace_path.empty())
+    {
+        utils::Profiler::print_summary(cout);
+        if (!utils::Profiler::write_chrome_trace(trace_path))
+            cout << "can't write " << trace_path << endl;
+    }
+    return 0;
+}
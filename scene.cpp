@@ -0,0 +1,55 @@
+#include <bits/stdc++.h>
+#include "softbody/softbody.h"
+
+#ifndef SCENE_CPP_
+#define SCENE_CPP_
+
+using namespace std;
+
+// Builds the demo body, a 3 by 1 box of braced squares under gravity.
+void build_scene(SoftBody *sb, double spring_coef, double damping_coef)
+{
+    vector<vec_t> positions = {
+        {1, 0.1},
+        {1.6, 0.1},
+        {2.2, 0.1},
+        {2.8, 0.1},
+        {1, 0.7},
+        {1.6, 0.7},
+        {2.2, 0.7},
+        {2.8, 0.7},
+    };
+    vector<Node> node_v;
+    for (vec_t p : positions)
+        node_v.push_back(sb->add_node(p, 0.2));
+
+    vector<pair<uint, uint>> edge_v = {
+        {0, 1},
+        {1, 2},
+        {2, 3},
+        {3, 7},
+        {7, 6},
+        {6, 5},
+        {5, 4},
+        {4, 0},
+
+        {0, 5},
+        {1, 4},
+        {1, 6},
+        {2, 5},
+        {2, 7},
+        {3, 6},
+
+        {1, 5},
+        {2, 6}};
+    for (auto e : edge_v)
+        sb->add_edge(node_v[e.first], node_v[e.second], spring_coef, damping_coef);
+
+    //sb->add_velocity({0, 0});
+    //sb->move_relative({1, 4.3});
+    sb->move_relative({1, 1.3});
+    vec_t g = {0, 9.81 * node_v[0].get_mass()};
+    sb->set_external_force(FORCE_GRAVITY, g);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <bits/stdc++.h>
 #include "./utils/vectors.cpp"
+#include "./utils/binary_file.cpp"
 #include "softbody/softbody.h"
 #include "simulator.h"
 
@@ -18,96 +19,794 @@ Simulator::Simulator(double bounce_coef, double friction_coef)
 
 void Simulator::handle_wall_collisions()
 {
+    for (SoftBody *b_ptr : this->bodies)
+        handle_wall_collisions(b_ptr);
+}
+
+void Simulator::handle_wall_collisions(SoftBody *b_ptr)
+{
+    PROFILE_SCOPE("Simulator::handle_wall_collisions");
     double disp_w = this->dsp_w_m;
     double disp_h = this->dsp_h_m;
-    vector<double> normal_f, friction_f;
-    vector<double> a, v, p;
+    vec_t normal_f, friction_f;
 
-    for (SoftBody *b_ptr : this->bodies)
+    NodeStore *nodes = b_ptr->get_nodes();
+    uint n = nodes->size();
+    double *px = nodes->position[0].data(), *py = nodes->position[1].data();
+    double *vx = nodes->velocity[0].data(), *vy = nodes->velocity[1].data();
+    double *ax = nodes->acceleration[0].data(), *ay = nodes->acceleration[1].data();
+    // force sums from this step's integration, no node forces change before they're read here
+    const double *fx = nodes->force[0].data(), *fy = nodes->force[1].data();
+    double *normal_x = nodes->slot_force[FORCE_NORMAL][0].data(), *normal_y = nodes->slot_force[FORCE_NORMAL][1].data();
+    double *friction_x = nodes->slot_force[FORCE_FRICTION][0].data(), *friction_y = nodes->slot_force[FORCE_FRICTION][1].data();
+
+    for (uint i = 0; i < n; i++)
     {
-        vector<Node> *nodes = b_ptr->get_nodes();
-        vector<Node>::iterator n_ptr = nodes->begin();
-        for (; n_ptr != nodes->end(); n_ptr++)
+        normal_f = vec_t{};
+        friction_f = vec_t{};
+
+        // floor/ceiling collision
+        if (py[i] >= disp_h || py[i] <= 0)
         {
-            a = n_ptr->get_acceleration();
-            v = n_ptr->get_velocity();
-            p = n_ptr->get_position();
-            normal_f = {0, 0};
-            friction_f = {0, 0};
-
-            // floor/ceiling collision
-            if (p[1] >= disp_h || p[1] <= 0)
+            normal_f = {0, -1 * fy[i]};
+            friction_f = {-sign(vx[i]) * fabs(fy[i]) * this->friction_coef, 0};
+
+            ay[i] = 0;
+            vy[i] = -1 * vy[i] * this->bounce_coef;
+
+            if (py[i] > 0)
+                py[i] = disp_h;
+            else
+                py[i] = 0;
+        }
+        // right/left wall collision
+        if (px[i] >= disp_w || px[i] <= 0)
+        {
+            normal_f = {-1 * fx[i], 0};
+            friction_f = {0, -sign(vy[i]) * fabs(fx[i]) * this->friction_coef};
+
+            ax[i] = 0;
+            vx[i] = -1 * vx[i] * this->bounce_coef;
+
+            if (px[i] > 0)
+                px[i] = disp_w;
+            else
+                px[i] = 0;
+        }
+
+        normal_x[i] = normal_f[0];
+        normal_y[i] = normal_f[1];
+        friction_x[i] = friction_f[0];
+        friction_y[i] = friction_f[1];
+    }
+}
+
+// Moves every edge to the cell of its midpoint. The cells are sized so that any node within contact_radius of an
+// edge is in the edge's cell or a neighbouring one, the hash is rebuilt when an edge outgrows them or edges were
+// added or torn.
+void Simulator::update_edge_hash()
+{
+    uint edge_count = 0;
+    bool topology_changed = this->edge_start.size() != this->bodies.size() + 1;
+    double max_half_length = 0;
+    for (uint b = 0; b < this->bodies.size(); b++)
+    {
+        if (!topology_changed && this->edge_start[b] != edge_count)
+            topology_changed = true;
+
+        EdgeTable *edges = this->bodies[b]->get_edges();
+        for (uint e = 0; e < edges->size(); e++)
+            max_half_length = max(max_half_length, (edges->rest_length[e] + edges->deformation[e]) / 2);
+        edge_count += edges->size();
+    }
+    topology_changed = topology_changed || this->edge_start.back() != edge_count;
+
+    double needed_cell_size = max_half_length + this->contact_radius;
+    bool rebuild = topology_changed || needed_cell_size > this->edge_hash.get_cell_size();
+    if (rebuild)
+    {
+        this->edge_start.assign(1, 0);
+        this->edge_body.clear();
+        for (uint b = 0; b < this->bodies.size(); b++)
+        {
+            uint count = this->bodies[b]->get_edges()->size();
+            this->edge_start.push_back(this->edge_start.back() + count);
+            this->edge_body.insert(this->edge_body.end(), count, b);
+        }
+        for (uint d = 0; d < DIMENSIONS; d++)
+        {
+            this->edge_end1[d].resize(edge_count);
+            this->edge_end2[d].resize(edge_count);
+        }
+        // some slack so stretching edges don't rebuild the hash every step
+        this->edge_hash.reset(edge_count, max(needed_cell_size * 1.25, 1e-6));
+    }
+
+    for (uint b = 0; b < this->bodies.size(); b++)
+    {
+        // sleeping bodies don't move
+        if (this->bodies[b]->is_sleeping() && !rebuild)
+            continue;
+        NodeStore *nodes = this->bodies[b]->get_nodes();
+        EdgeTable *edges = this->bodies[b]->get_edges();
+        for (uint e = 0; e < edges->size(); e++)
+        {
+            uint item = this->edge_start[b] + e;
+            vec_t mid;
+            for (uint d = 0; d < DIMENSIONS; d++)
             {
-                normal_f = {0, -1 * n_ptr->force_sum()[1]};
-                friction_f = {-sign(v[0]) * vector_len(normal_f) * this->friction_coef, 0};
+                this->edge_end1[d][item] = nodes->position[d][edges->node1[e]];
+                this->edge_end2[d][item] = nodes->position[d][edges->node2[e]];
+                mid[d] = (this->edge_end1[d][item] + this->edge_end2[d][item]) / 2;
+            }
+            this->edge_hash.update(item, mid);
+        }
+    }
+}
 
-                a[1] = 0;
-                v[1] = -1 * v[1] * this->bounce_coef;
+// Collects the contacts of the nodes of one block, only reads the bodies.
+void Simulator::find_contacts(const query_block_t &block, vector<contact_t> *out)
+{
+    SoftBody *node_body = this->bodies[block.body];
+    NodeStore *nodes = node_body->get_nodes();
+    double radius_sq = this->contact_radius * this->contact_radius;
+
+    for (uint n = block.begin; n < block.end; n++)
+    {
+        uint first_contact = out->size();
+        vec_t p;
+        for (uint d = 0; d < DIMENSIONS; d++)
+            p[d] = nodes->position[d][n];
+
+        this->edge_hash.query(p, [&](uint item) {
+            uint b = this->edge_body[item];
+            if (b == block.body || (node_body->is_sleeping() && this->bodies[b]->is_sleeping()))
+                return;
 
-                if (p[1] > 0)
-                    p[1] = disp_h;
-                else
-                    p[1] = 0;
+            // closest point of the edge to the node
+            vec_t a, ab;
+            double len_sq = 0, along = 0;
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                a[d] = this->edge_end1[d][item];
+                ab[d] = this->edge_end2[d][item] - a[d];
+                len_sq += ab[d] * ab[d];
+                along += (p[d] - a[d]) * ab[d];
             }
-            // right/left wall collision
-            if (p[0] >= disp_w || p[0] <= 0)
+            double t = len_sq > 0 ? min(max(along / len_sq, 0.), 1.) : 0;
+            vec_t diff = p - (a + ab * t);
+            double dist_sq = dot_product(diff, diff);
+            if (dist_sq >= radius_sq)
+                return;
+
+            double dist = sqrt(dist_sq);
+            vec_t normal{};
+            if (dist > 0)
+                normal = diff * (1 / dist);
+            else if (len_sq > 0)
             {
-                normal_f = {-1 * n_ptr->force_sum()[0], 0};
-                friction_f = {0, -sign(v[1]) * vector_len(normal_f) * this->friction_coef};
+                // node exactly on the edge, push it out sideways
+                normal[0] = -ab[1];
+                normal[1] = ab[0];
+                normal = unit_vector(normal);
+            }
+            out->push_back({node_body, n, this->bodies[b], item - this->edge_start[b], block.body, b, t, dist, normal});
+        });
 
-                a[0] = 0;
-                v[0] = -1 * v[0] * this->bounce_coef;
+        // the order of the items of a cell depends on the history of the hash, contacts are applied in edge order
+        // so that a rebuilt hash gives the same result
+        sort(out->begin() + first_contact, out->end(), [](const contact_t &a, const contact_t &b) {
+            return a.edge_body_index != b.edge_body_index ? a.edge_body_index < b.edge_body_index : a.edge < b.edge;
+        });
+    }
+}
 
-                if (p[0] > 0)
-                    p[0] = disp_w;
-                else
-                    p[0] = 0;
-            }
+// Separates the node and the edge along the normal in proportion to their inverse masses, then removes the
+// approaching normal velocity with an impulse and applies friction to the tangential velocity.
+void Simulator::apply_contact(const contact_t &c)
+{
+    NodeStore *nodes = c.node_body->get_nodes();
+    NodeStore *edge_nodes = c.edge_body->get_nodes();
+    EdgeTable *edges = c.edge_body->get_edges();
+    uint n1 = edges->node1[c.edge], n2 = edges->node2[c.edge];
+    double w1 = 1 - c.t, w2 = c.t;
+    double im = nodes->inv_mass[c.node], im1 = edge_nodes->inv_mass[n1], im2 = edge_nodes->inv_mass[n2];
+    double w = im + w1 * w1 * im1 + w2 * w2 * im2;
+    if (w <= 0)
+        return;
+
+    // recheck, earlier contacts may have moved the node or the edge
+    vec_t diff;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        diff[d] = nodes->position[d][c.node] - (edge_nodes->position[d][n1] * w1 + edge_nodes->position[d][n2] * w2);
+    double penetration = this->contact_radius - dot_product(diff, c.normal);
+    if (penetration <= 0)
+        return;
+
+    double move = penetration / w;
+    vec_t relative_v;
+    for (uint d = 0; d < DIMENSIONS; d++)
+    {
+        nodes->position[d][c.node] += c.normal[d] * move * im;
+        edge_nodes->position[d][n1] -= c.normal[d] * move * im1 * w1;
+        edge_nodes->position[d][n2] -= c.normal[d] * move * im2 * w2;
+        relative_v[d] = nodes->velocity[d][c.node] - (edge_nodes->velocity[d][n1] * w1 + edge_nodes->velocity[d][n2] * w2);
+    }
+
+    double v_normal = dot_product(relative_v, c.normal);
+    if (v_normal >= 0)
+        return;
+    double j = -(1 + this->bounce_coef) * v_normal / w;
+    vec_t impulse = c.normal * j;
 
-            n_ptr->set_force("normal", normal_f);
-            n_ptr->set_force("friction", friction_f);
-            n_ptr->set_acceleration(a);
-            n_ptr->set_velocity(v);
-            n_ptr->set_position(p);
+    vec_t v_tangent = relative_v - c.normal * v_normal;
+    double tangent_len = vector_len(v_tangent);
+    if (tangent_len > 0)
+    {
+        double jt = min(this->friction_coef * j, tangent_len / w);
+        impulse -= v_tangent * (jt / tangent_len);
+    }
+
+    for (uint d = 0; d < DIMENSIONS; d++)
+    {
+        nodes->velocity[d][c.node] += impulse[d] * im;
+        edge_nodes->velocity[d][n1] -= impulse[d] * im1 * w1;
+        edge_nodes->velocity[d][n2] -= impulse[d] * im2 * w2;
+    }
+}
+
+// The broadphase is updated on the calling thread, the nodes are then queried in blocks on the pool. Every block
+// collects its contacts into its own list and the lists are applied in block order, so the result doesn't depend
+// on the thread count.
+void Simulator::handle_body_collisions()
+{
+    PROFILE_SCOPE("Simulator::handle_body_collisions");
+    if (this->bodies.size() < 2)
+        return;
+    // sleeping bodies don't touch each other
+    if (this->sleeping_count == this->bodies.size())
+    {
+        this->last_contact_count = 0;
+        return;
+    }
+    update_edge_hash();
+
+    this->query_blocks.clear();
+    for (uint b = 0; b < this->bodies.size(); b++)
+    {
+        uint n = this->bodies[b]->get_nodes()->size();
+        for (uint begin = 0; begin < n; begin += CONTACT_QUERY_BLOCK)
+            this->query_blocks.push_back({b, begin, min(begin + CONTACT_QUERY_BLOCK, n)});
+    }
+    while (this->block_contacts.size() < this->query_blocks.size())
+    {
+        this->block_contacts.emplace_back();
+        this->block_contacts.back().reserve(CONTACT_BLOCK_RESERVE);
+    }
+
+    auto query = [&](uint begin, uint end) {
+        for (uint i = begin; i < end; i++)
+        {
+            this->block_contacts[i].clear();
+            find_contacts(this->query_blocks[i], &this->block_contacts[i]);
+        }
+    };
+    if (this->pool)
+        this->pool->parallel_for(this->query_blocks.size(), query);
+    else
+        query(0, this->query_blocks.size());
+
+    this->last_contact_count = 0;
+    for (uint i = 0; i < this->query_blocks.size(); i++)
+    {
+        for (const contact_t &c : this->block_contacts[i])
+        {
+            if (this->sleeping)
+            {
+                // one of the two is awake
+                if (c.node_body->is_sleeping())
+                    wake_island(c.node_body_index);
+                if (c.edge_body->is_sleeping())
+                    wake_island(c.edge_body_index);
+                this->island_parent[find_island(c.node_body_index)] = find_island(c.edge_body_index);
+            }
+            apply_contact(c);
         }
+        this->last_contact_count += this->block_contacts[i].size();
     }
 }
 
+void Simulator::set_body_collisions(bool enabled, double contact_radius)
+{
+    this->body_collisions = enabled;
+    this->contact_radius = contact_radius;
+    // cells depend on the radius
+    this->edge_start.clear();
+}
+
+uint Simulator::get_contact_count()
+{
+    return this->last_contact_count;
+}
+
+void Simulator::set_thread_count(uint thread_count)
+{
+    if (thread_count > 1)
+        this->pool.reset(new utils::ThreadPool(thread_count));
+    else
+        this->pool.reset();
+
+    for (SoftBody *b_ptr : this->bodies)
+        b_ptr->set_thread_pool(this->pool.get());
+}
+
+void Simulator::set_deterministic(bool deterministic)
+{
+    this->deterministic = deterministic;
+    for (SoftBody *b_ptr : this->bodies)
+        b_ptr->set_deterministic(deterministic);
+}
+
 void Simulator::add_body(SoftBody *body)
 {
+    body->set_thread_pool(this->pool.get());
+    body->set_deterministic(this->deterministic);
     this->bodies.push_back(body);
+    this->calm_frames.push_back(0);
+    this->island_parent.push_back(this->bodies.size() - 1);
+    this->island_ready.push_back(false);
+    this->sleep_island.push_back(0);
+    if (body->is_sleeping())
+        body->wake();
+    this->packed_stale = true;
+}
+
+uint Simulator::get_body_count()
+{
+    return this->bodies.size();
+}
+
+SoftBody *Simulator::get_body(uint index)
+{
+    return this->bodies[index];
+}
+
+static const uint32_t CHECKPOINT_MAGIC = 0x4b435342; // "BSCK" in native byte order
+
+// header, the fields of checkpoint_fields, the body count and every body
+bool Simulator::save_checkpoint(const string &path)
+{
+    string temp_path = path + ".tmp";
+    utils::BinaryWriter out(temp_path);
+    out.write(CHECKPOINT_MAGIC);
+    out.write((uint32_t)CHECKPOINT_VERSION);
+    out.write((uint32_t)DIMENSIONS);
+    out.write((uint32_t)FORCE_SLOT_COUNT);
+
+    checkpoint_fields([&](auto &field) {
+        if constexpr (is_trivially_copyable<remove_reference_t<decltype(field)>>::value)
+            out.write(field);
+        else
+            out.write_array(field);
+    });
+    out.write((uint32_t)this->bodies.size());
+    for (SoftBody *b_ptr : this->bodies)
+        b_ptr->write(&out);
+
+    if (!out.close())
+    {
+        remove(temp_path.c_str());
+        return false;
+    }
+    return rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool Simulator::restore_checkpoint(const string &path)
+{
+    utils::BinaryReader in(path);
+    uint32_t magic = 0, version = 0, dimensions = 0, slot_count = 0;
+    in.read(&magic);
+    in.read(&version);
+    in.read(&dimensions);
+    in.read(&slot_count);
+    if (!in.good() || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION || dimensions != DIMENSIONS || slot_count != FORCE_SLOT_COUNT)
+        return false;
+
+    auto read_field = [&](auto &field) {
+        if constexpr (is_trivially_copyable<remove_reference_t<decltype(field)>>::value)
+            in.read(&field);
+        else
+            in.read_array(&field);
+    };
+    // read into a scratch simulator first so a bad file leaves this one as it is
+    size_t fields_offset = in.tell();
+    Simulator scratch;
+    scratch.checkpoint_fields(read_field);
+    uint32_t body_count = 0;
+    in.read(&body_count);
+    if (!in.good() || scratch.calm_frames.size() != body_count || scratch.sleep_island.size() != body_count)
+        return false;
+
+    vector<unique_ptr<SoftBody>> restored;
+    for (uint i = 0; i < body_count; i++)
+    {
+        restored.emplace_back(new SoftBody());
+        if (!restored.back()->read(&in))
+            return false;
+    }
+
+    size_t end_offset = in.tell();
+    in.seek(fields_offset);
+    checkpoint_fields(read_field);
+    in.seek(end_offset);
+
+    this->owned_bodies.swap(restored);
+    this->bodies.clear();
+    for (unique_ptr<SoftBody> &b_ptr : this->owned_bodies)
+    {
+        b_ptr->set_thread_pool(this->pool.get());
+        b_ptr->set_deterministic(this->deterministic);
+        this->bodies.push_back(b_ptr.get());
+    }
+    this->island_parent.resize(body_count);
+    iota(this->island_parent.begin(), this->island_parent.end(), 0);
+    this->island_ready.assign(body_count, false);
+    // rebuilds the broadphase on the next step
+    this->edge_start.clear();
+    // the new tables may have the addresses of the freed ones
+    this->packed_tables.clear();
+    this->packed_stale = true;
+    return true;
 }
 
 void Simulator::__apply_air_resistance() {}
 
 void Simulator::simulate_next_frame(double time_step_s)
 {
+    PROFILE_SCOPE("Simulator::simulate_next_frame");
+    if (this->sleeping)
+    {
+        for (uint i = 0; i < this->bodies.size(); i++)
+        {
+            this->island_parent[i] = i;
+            if (this->bodies[i]->is_sleeping() && this->bodies[i]->forces_changed_while_sleeping())
+                wake_island(i);
+        }
+    }
+
+    if (this->adaptive)
+        simulate_adaptive(time_step_s);
+    else
+        step(time_step_s);
+
+    if (this->sleeping)
+        update_sleeping();
+
+    this->packed_stale = true;
+    if (this->frame_listener)
+        this->frame_listener->on_frame(this, time_step_s);
+}
+
+void Simulator::set_frame_listener(_FrameListener *listener)
+{
+    this->frame_listener = listener;
+}
+
+uint Simulator::find_island(uint body)
+{
+    while (this->island_parent[body] != body)
+    {
+        this->island_parent[body] = this->island_parent[this->island_parent[body]];
+        body = this->island_parent[body];
+    }
+    return body;
+}
+
+void Simulator::wake_island(uint body)
+{
+    uint island = this->sleep_island[body];
+    for (uint i = 0; i < this->bodies.size(); i++)
+    {
+        if (!this->bodies[i]->is_sleeping() || this->sleep_island[i] != island)
+            continue;
+        this->bodies[i]->wake();
+        this->calm_frames[i] = 0;
+        this->sleeping_count--;
+    }
+}
+
+void Simulator::save_sleep_state()
+{
+    if (!this->sleeping)
+        return;
+    uint body_count = this->bodies.size();
+    this->start_sleeping.resize(body_count);
+    for (uint i = 0; i < body_count; i++)
+        this->start_sleeping[i] = this->bodies[i]->is_sleeping();
+    this->start_calm_frames.assign(this->calm_frames.begin(), this->calm_frames.end());
+    this->start_island_parent.assign(this->island_parent.begin(), this->island_parent.end());
+    this->start_sleeping_count = this->sleeping_count;
+}
+
+// Steps only wake bodies, so the bodies asleep at the start that are awake now go back to sleep. Their nodes were
+// restored too and are as they fell asleep.
+void Simulator::restore_sleep_state()
+{
+    if (!this->sleeping)
+        return;
+    for (uint i = 0; i < this->bodies.size(); i++)
+        if (this->start_sleeping[i] && !this->bodies[i]->is_sleeping())
+            this->bodies[i]->sleep();
+    this->calm_frames.assign(this->start_calm_frames.begin(), this->start_calm_frames.end());
+    this->island_parent.assign(this->start_island_parent.begin(), this->start_island_parent.end());
+    this->sleeping_count = this->start_sleeping_count;
+}
+
+// Counts the calm frames of the awake bodies and puts the islands whose bodies have all been calm long enough to
+// sleep. Bodies that touched a sleeping body this frame woke it, so an island is either all awake or all asleep.
+void Simulator::update_sleeping()
+{
+    uint body_count = this->bodies.size();
+    for (uint i = 0; i < body_count; i++)
+    {
+        SoftBody *b_ptr = this->bodies[i];
+        if (b_ptr->is_sleeping())
+            continue;
+        if (b_ptr->get_kinetic_energy() <= this->sleep_energy * b_ptr->get_mass())
+            this->calm_frames[i]++;
+        else
+            this->calm_frames[i] = 0;
+    }
+
+    fill(this->island_ready.begin(), this->island_ready.end(), true);
+    for (uint i = 0; i < body_count; i++)
+        if (!this->bodies[i]->is_sleeping() && this->calm_frames[i] < this->sleep_frames)
+            this->island_ready[find_island(i)] = false;
+
+    for (uint i = 0; i < body_count; i++)
+    {
+        uint island = find_island(i);
+        if (this->bodies[i]->is_sleeping() || !this->island_ready[island])
+            continue;
+        this->bodies[i]->sleep();
+        this->sleep_island[i] = island;
+        this->sleeping_count++;
+    }
+}
+
+void Simulator::set_sleeping(bool enabled, double sleep_energy, uint sleep_frames)
+{
+    this->sleeping = enabled;
+    this->sleep_energy = sleep_energy;
+    this->sleep_frames = sleep_frames;
+    if (enabled)
+        return;
+    for (uint i = 0; i < this->bodies.size(); i++)
+    {
+        this->bodies[i]->wake();
+        this->calm_frames[i] = 0;
+    }
+    this->sleeping_count = 0;
+}
+
+uint Simulator::get_awake_body_count()
+{
+    return this->bodies.size() - this->sleeping_count;
+}
+
+uint Simulator::get_sleeping_body_count()
+{
+    return this->sleeping_count;
+}
+
+// Bodies don't interact, so each body is stepped and collided with the walls as its own task.
+// The tasks run on the pool's threads when there is one, a big body splits its own work into more tasks.
+// XPBD bodies handle the walls as constraints inside their step. Sleeping bodies are skipped.
+void Simulator::step(double time_step_s)
+{
+    auto step_bodies = [&](uint begin, uint end) {
+        for (uint i = begin; i < end; i++)
+        {
+            SoftBody *b_ptr = this->bodies[i];
+            if (b_ptr->is_sleeping())
+                continue;
+            bool xpbd = b_ptr->get_integration_method() == INTEGRATE_XPBD;
+            if (xpbd)
+                b_ptr->set_contact_box(vec_t{}, vec_t{this->dsp_w_m, this->dsp_h_m}, this->bounce_coef, this->friction_coef);
+
+            b_ptr->advance_physics(time_step_s);
+            if (!xpbd)
+                handle_wall_collisions(b_ptr);
+        }
+    };
+
+    if (this->pool)
+        this->pool->parallel_for(this->bodies.size(), step_bodies, this->bodies.size());
+    else
+        step_bodies(0, this->bodies.size());
+
+    if (this->body_collisions)
+        handle_body_collisions();
+}
+
+void Simulator::simulate_adaptive(double frame_time_s)
+{
+    uint body_count = this->bodies.size();
+    this->start_states.resize(body_count);
+    this->trial_states.resize(body_count);
+
+    double stable_dt = numeric_limits<double>::infinity();
     for (SoftBody *b_ptr : this->bodies)
-        b_ptr->advance_physics(time_step_s);
-    handle_wall_collisions();
+        stable_dt = min(stable_dt, b_ptr->get_stable_time_step());
+    // the whole trial step has to be stable too
+    double max_dt = max(min(this->max_dt, 0.9 * stable_dt), this->min_dt);
+
+    double remaining = frame_time_s;
+    while (remaining > frame_time_s * 1e-9)
+    {
+        double dt = min(max(min(this->next_dt, max_dt), this->min_dt), remaining);
+
+        for (uint i = 0; i < body_count; i++)
+            this->bodies[i]->save_state(&this->start_states[i]);
+        save_sleep_state();
+        step(dt);
+        for (uint i = 0; i < body_count; i++)
+        {
+            this->bodies[i]->save_state(&this->trial_states[i]);
+            this->bodies[i]->restore_state(this->start_states[i]);
+        }
+        restore_sleep_state();
+        step(dt / 2);
+        step(dt / 2);
+
+        double error = 0;
+        for (uint i = 0; i < body_count; i++)
+        {
+            NodeStore *nodes = this->bodies[i]->get_nodes();
+            NodeStore *trial = &this->trial_states[i].nodes;
+            for (uint d = 0; d < DIMENSIONS; d++)
+                for (uint n = 0; n < nodes->size(); n++)
+                    error = max(error, fabs(nodes->position[d][n] - trial->position[d][n]));
+        }
+
+        // the error of a step shrinks at least with dt^2
+        double factor = error > 0 ? 0.9 * sqrt(this->tolerance / error) : 2;
+        this->next_dt = min(max(dt * min(max(factor, 0.2), 2.), this->min_dt), max_dt);
+
+        if (error > this->tolerance && dt > this->min_dt)
+        {
+            for (uint i = 0; i < body_count; i++)
+                this->bodies[i]->restore_state(this->start_states[i]);
+            restore_sleep_state();
+            this->rejected_steps++;
+            continue;
+        }
+
+        // keep the result of the two halves, the more accurate one
+        remaining -= dt;
+        if (this->dt_history.size() < DT_HISTORY_LENGTH)
+            this->dt_history.push_back(dt);
+        else
+            this->dt_history[this->dt_history_next] = dt;
+        this->dt_history_next = (this->dt_history_next + 1) % DT_HISTORY_LENGTH;
+    }
+}
+
+void Simulator::set_adaptive_stepping(bool enabled, double tolerance, double min_dt, double max_dt)
+{
+    this->adaptive = enabled;
+    this->tolerance = tolerance;
+    this->min_dt = min_dt;
+    this->max_dt = max(max_dt, min_dt);
+    this->next_dt = this->min_dt;
+    // a full history is written in place, so steps don't allocate
+    if (enabled)
+        this->dt_history.reserve(DT_HISTORY_LENGTH);
+}
+
+void Simulator::get_dt_history(vector<double> *out)
+{
+    uint n = this->dt_history.size();
+    uint oldest = n < DT_HISTORY_LENGTH ? 0 : this->dt_history_next;
+    for (uint i = 0; i < n; i++)
+        out->push_back(this->dt_history[(oldest + i) % n]);
+}
+
+uint Simulator::get_rejected_steps()
+{
+    return this->rejected_steps;
 }
 
-void Simulator::get_all_nodes(vector<Node*> *out)
+void Simulator::get_all_nodes(vector<Node> *out)
 {
     for (auto b : this->bodies) {
-        vector<Node> *ns = b->get_nodes();
-        vector<Node>::iterator n_itr = ns->begin();
-        while (n_itr != ns->end()) {
-            out->push_back(&*n_itr);
-            n_itr++;
-        }
+        NodeStore *ns = b->get_nodes();
+        for (uint i = 0; i < ns->size(); i++)
+            out->push_back(Node(ns, i));
     }
 }
-void Simulator::get_all_edges(vector<Edge*> *out)
+void Simulator::get_all_edges(vector<Edge> *out)
 {
     for (auto b : this->bodies) {
-        list<Edge> *es = b->get_edges();
-        list<Edge>::iterator e_itr = es->begin();
-        while (e_itr != es->end()) {
-            out->push_back(&*e_itr);
-            e_itr++;
+        EdgeTable *es = b->get_edges();
+        for (uint i = 0; i < es->size(); i++)
+            out->push_back(b->get_edge(i));
+    }
+}
+
+// Positions are copied every time. The edge nodes are only packed again when the table or version of a body's edges
+// changed or the nodes of a body moved.
+void Simulator::pack_state()
+{
+    uint body_count = this->bodies.size();
+    bool nodes_moved = this->node_start.size() != body_count + 1;
+    this->node_start.resize(body_count + 1, 0);
+    for (uint b = 0; b < body_count; b++)
+    {
+        uint end = this->node_start[b] + this->bodies[b]->get_nodes()->size();
+        nodes_moved = nodes_moved || this->node_start[b + 1] != end;
+        this->node_start[b + 1] = end;
+    }
+
+    this->packed_positions.resize(this->node_start.back());
+    for (uint b = 0; b < body_count; b++)
+    {
+        NodeStore *nodes = this->bodies[b]->get_nodes();
+        vec_t *out = this->packed_positions.data() + this->node_start[b];
+        for (uint i = 0; i < nodes->size(); i++)
+            for (uint d = 0; d < DIMENSIONS; d++)
+                out[i][d] = nodes->position[d][i];
+    }
+
+    bool edges_changed = nodes_moved || this->packed_tables.size() != body_count;
+    this->packed_tables.resize(body_count, NULL);
+    this->packed_edge_versions.resize(body_count, 0);
+    for (uint b = 0; b < body_count; b++)
+    {
+        EdgeTable *edges = this->bodies[b]->get_edges();
+        if (this->packed_tables[b] != edges || this->packed_edge_versions[b] != edges->version)
+        {
+            edges_changed = true;
+            this->packed_tables[b] = edges;
+            this->packed_edge_versions[b] = edges->version;
+        }
+    }
+    if (edges_changed)
+    {
+        this->packed_edge_nodes.clear();
+        for (uint b = 0; b < body_count; b++)
+        {
+            EdgeTable *edges = this->bodies[b]->get_edges();
+            uint start = this->node_start[b];
+            for (uint e = 0; e < edges->size(); e++)
+            {
+                this->packed_edge_nodes.push_back(start + edges->node1[e]);
+                this->packed_edge_nodes.push_back(start + edges->node2[e]);
+            }
         }
     }
+    this->packed_stale = false;
+}
+
+utils::span<vec_t> Simulator::get_positions()
+{
+    if (this->packed_stale)
+        pack_state();
+    return utils::span<vec_t>(this->packed_positions.data(), this->packed_positions.size());
+}
+
+utils::span<uint> Simulator::get_edge_nodes()
+{
+    if (this->packed_stale)
+        pack_state();
+    return utils::span<uint>(this->packed_edge_nodes.data(), this->packed_edge_nodes.size());
+}
+
+utils::span<uint> Simulator::get_node_starts()
+{
+    if (this->packed_stale)
+        pack_state();
+    return utils::span<uint>(this->node_start.data(), this->node_start.size());
 }
 
 #endif
\ No newline at end of file
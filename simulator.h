@@ -1,20 +1,166 @@
 #include <bits/stdc++.h>
 #include "softbody/softbody.h"
+#include "utils/spatial_hash.cpp"
+#include "utils/span.cpp"
 
 #ifndef SIMULATOR_H_
 #define SIMULATOR_H_
 
+// nodes per block of the parallel contact query
+#define CONTACT_QUERY_BLOCK 1024
+// contacts a query block has room for up front, so that contacts appearing while the bodies settle don't grow
+// the lists one frame at a time
+#define CONTACT_BLOCK_RESERVE 64
+// number of recent step sizes kept by the adaptive mode
+#define DT_HISTORY_LENGTH 4096
+// format of the files written by Simulator::save_checkpoint, bumped whenever the saved state changes
+#define CHECKPOINT_VERSION 1
+
 using namespace std;
 
 template <typename T>
 int sign(T n) { return (0 < n) - (n < 0); }
 
+// A node of one body closer than the contact radius to an edge of another body.
+struct contact_t
+{
+    SoftBody *node_body;
+    uint node;
+    SoftBody *edge_body;
+    uint edge;
+    // indices of the bodies in the simulator
+    uint node_body_index;
+    uint edge_body_index;
+    double t; // position of the closest point along the edge, 0 at node1 and 1 at node2
+    double distance;
+    vec_t normal; // from the edge towards the node
+};
+
+class Simulator;
+
+// Sees every frame of the simulator it's attached to, see Simulator::set_frame_listener.
+class _FrameListener
+{
+public:
+    virtual ~_FrameListener() = default;
+    // called on the simulating thread at the end of every simulate_next_frame, must not modify the simulator
+    virtual void on_frame(Simulator *s, double time_step_s) = 0;
+};
+
 class Simulator
 {
 private:
     double bounce_coef;
     double friction_coef;
     vector<SoftBody *> bodies;
+    // bodies created by restore_checkpoint
+    vector<unique_ptr<SoftBody>> owned_bodies;
+    unique_ptr<utils::ThreadPool> pool;
+    bool deterministic = true;
+    _FrameListener *frame_listener = NULL;
+
+    // contacts between bodies, see set_body_collisions
+    bool body_collisions = true;
+    double contact_radius = 0.02;
+    // broadphase of the edges of every body by their midpoint, item i is edge i - edge_start[b] of body b
+    utils::SpatialHash edge_hash;
+    vector<uint> edge_start;
+    // body and end points of every item, copied when the hash is updated so queries read contiguous memory
+    vector<uint> edge_body;
+    vector<double> edge_end1[DIMENSIONS];
+    vector<double> edge_end2[DIMENSIONS];
+    struct query_block_t
+    {
+        uint body;
+        uint begin, end;
+    };
+    vector<query_block_t> query_blocks;
+    vector<vector<contact_t>> block_contacts;
+    uint last_contact_count = 0;
+
+    void update_edge_hash();
+    void find_contacts(const query_block_t &block, vector<contact_t> *out);
+    void apply_contact(const contact_t &c);
+
+    // adaptive stepping, see set_adaptive_stepping
+    bool adaptive = false;
+    double tolerance = 1e-4;
+    double min_dt = 1e-5;
+    double max_dt = 1e-2;
+    double next_dt = 1e-3;
+    uint rejected_steps = 0;
+    // ring of the most recent accepted step sizes
+    vector<double> dt_history;
+    uint dt_history_next = 0;
+    vector<body_state> start_states;
+    vector<body_state> trial_states;
+
+    void step(double time_step_s);
+    void simulate_adaptive(double frame_time_s);
+
+    // sleeping, see set_sleeping
+    bool sleeping = false;
+    double sleep_energy = 1e-3;
+    uint sleep_frames = 60;
+    uint sleeping_count = 0;
+    // frames each body has been under sleep_energy
+    vector<uint> calm_frames;
+    // bodies touching each other during the frame, union find over the body indices
+    vector<uint> island_parent;
+    vector<bool> island_ready;
+    // island a sleeping body fell asleep with, the whole island wakes together
+    vector<uint> sleep_island;
+
+    // sleep state at the start of an adaptive step. The trial step and a rejected step may wake islands the kept
+    // steps never touch, they're put back to sleep with it.
+    vector<uint8_t> start_sleeping;
+    vector<uint> start_calm_frames;
+    vector<uint> start_island_parent;
+    uint start_sleeping_count = 0;
+
+    uint find_island(uint body);
+    void wake_island(uint body);
+    void update_sleeping();
+    void save_sleep_state();
+    void restore_sleep_state();
+
+    // every position and edge packed for readers, see get_positions
+    bool packed_stale = true;
+    vector<vec_t> packed_positions;
+    vector<uint> packed_edge_nodes;
+    vector<uint> node_start;
+    // table and edge count of every body when the edges were packed
+    vector<EdgeTable *> packed_tables;
+    vector<uint64_t> packed_edge_versions;
+
+    void pack_state();
+
+    // calls fn(field) for every member saved in a checkpoint besides the bodies
+    template <typename _F>
+    void checkpoint_fields(const _F &fn)
+    {
+        fn(this->bounce_coef);
+        fn(this->friction_coef);
+        fn(this->dsp_w_m);
+        fn(this->dsp_h_m);
+        fn(this->body_collisions);
+        fn(this->contact_radius);
+        fn(this->last_contact_count);
+        fn(this->adaptive);
+        fn(this->tolerance);
+        fn(this->min_dt);
+        fn(this->max_dt);
+        fn(this->next_dt);
+        fn(this->rejected_steps);
+        fn(this->dt_history);
+        fn(this->dt_history_next);
+        fn(this->sleeping);
+        fn(this->sleep_energy);
+        fn(this->sleep_frames);
+        fn(this->sleeping_count);
+        fn(this->calm_frames);
+        fn(this->sleep_island);
+    }
 
 public:
     double dsp_w_m = 5;
@@ -24,12 +170,64 @@ public:
     Simulator(double bounce_coef, double friction_coef);
 
     void handle_wall_collisions();
+    void handle_wall_collisions(SoftBody *body);
+    // Pushes nodes of a body out of the edges of other bodies, applied after every step when enabled.
+    // Nodes and edges are kept contact_radius apart, the velocities along the contact normal bounce with
+    // bounce_coef and tangential velocities lose friction_coef of the normal impulse.
+    void handle_body_collisions();
+    void set_body_collisions(bool enabled, double contact_radius);
+    uint get_contact_count();
     void __apply_air_resistance();
     void simulate_next_frame(double time_step_s);
 
+    // In adaptive mode simulate_next_frame advances by its time step in as many steps as needed. Each step is
+    // taken once whole and once as two halves, the largest difference of a node's position is the error estimate.
+    // Steps with an error over tolerance (in meters) are retried smaller, steps never go below min_dt and stay
+    // under max_dt and the stability bound of explicit bodies.
+    void set_adaptive_stepping(bool enabled, double tolerance, double min_dt, double max_dt);
+    // accepted step sizes, oldest first, up to DT_HISTORY_LENGTH of them
+    void get_dt_history(vector<double> *out);
+    uint get_rejected_steps();
+
+    // Bodies resting for sleep_frames frames in a row fall asleep and are skipped until something wakes them.
+    // A body rests while its kinetic energy per kilogram stays under sleep_energy, bodies in contact form an
+    // island that only falls asleep as a whole. A sleeping island wakes when a node of one of its bodies is pulled
+    // or gets another slot force, when an external force of one of its bodies changes or when an awake body
+    // touches it.
+    void set_sleeping(bool enabled, double sleep_energy, uint sleep_frames);
+    uint get_awake_body_count();
+    uint get_sleeping_body_count();
+
+    // Writes every body and the state of the simulator to a versioned binary file, see CHECKPOINT_VERSION. The file
+    // is written next to path and renamed over it once complete, so a crash while saving keeps the old checkpoint.
+    bool save_checkpoint(const string &path);
+    // Replaces the bodies with the ones of a checkpoint, owned by the simulator, and restores its state. Stepping
+    // on continues exactly like the saved simulation would have, with any thread count when deterministic. The
+    // thread count and deterministic setting are kept. Returns false and changes nothing if the file can't be read
+    // or has another version.
+    bool restore_checkpoint(const string &path);
+
+    // the listener sees every frame until it's replaced, NULL for none. It's not part of a checkpoint.
+    void set_frame_listener(_FrameListener *listener);
+
+    void set_thread_count(uint thread_count);
+    // Deterministic stepping gives bit for bit the same states on any thread count and schedule, at the cost of
+    // summing fixed blocks, see SoftBody::set_deterministic. On by default, it's set on every body added.
+    void set_deterministic(bool deterministic);
     void add_body(SoftBody *body);
-    void get_all_nodes(vector<Node *> *out);
-    void get_all_edges(vector<Edge *> *out);
+    uint get_body_count();
+    SoftBody *get_body(uint index);
+    void get_all_nodes(vector<Node> *out);
+    void get_all_edges(vector<Edge> *out);
+
+    // The position of every node, body after body, and the indices of the two nodes of every edge into them,
+    // for reading the whole state without copying it. Packed on the first call after a step, later calls until
+    // the next step cost nothing. The spans stay valid until the next step, add_body or restore_checkpoint, changes
+    // made to the bodies directly show after the next step. Only for the thread stepping the simulator.
+    utils::span<vec_t> get_positions();
+    utils::span<uint> get_edge_nodes();
+    // get_body_count() + 1 entries, the nodes of body b are get_positions()[starts[b]] up to starts[b + 1]
+    utils::span<uint> get_node_starts();
 };
 
 #endif
@@ -1,6 +1,7 @@
 #include <bits/stdc++.h>
 
 #include "../utils/vectors.cpp"
+#include "../utils/binary_file.cpp"
 
 #include "node.h"
 #include "edge.h"
@@ -11,137 +12,358 @@
 using namespace std;
 using namespace utils::vectors;
 
-Edge::Edge() = default;
+static inline vec_t load(const vector<double> (&component)[DIMENSIONS], uint i) {
+    vec_t v;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        v[d] = component[d][i];
+    return v;
+}
 
-Edge::Edge(Node node1, Node node2, double spring_coef, double damping_coef, double rest_length) {
-    this->node1 = new Node(node1);
-    this->node2 = new Node(node2);
-    this->spring_coef = spring_coef;
-    this->damping_coef = damping_coef;
-    this->rest_length = rest_length;
+static inline void add_to(vector<double> (&component)[DIMENSIONS], uint i, const vec_t &v) {
+    for (uint d = 0; d < DIMENSIONS; d++)
+        component[d][i] += v[d];
 }
 
-// if rest_length not given, set rest_length as the current distance of nodes 1 and 2.
-Edge::Edge(Node node1, Node node2, double spring_coef, double damping_coef) {
-    this->node1 = new Node(node1);
-    this->node2 = new Node(node2);
-    this->spring_coef = spring_coef;
-    this->damping_coef = damping_coef;
+// Spring force acting on node 1, node 2 gets the same force negated. distance_vect points from node 1 to node 2.
+static inline vec_t spring_force(const vec_t &distance_vect, double distance, double deformation, double spring_coef) {
+    double magnitude = deformation * spring_coef;
+    double scale_factor = 0;
 
-    vector<double> p1 = this->node1->get_position();
-    vector<double> p2 = this->node2->get_position();
-    this->rest_length = vector_len(vector_sub(p2, p1));
+    if (distance != 0) {
+        scale_factor = magnitude / distance;
+    }
+
+    return distance_vect * scale_factor;
 }
 
-Edge::Edge(Node *node1, Node *node2, double spring_coef, double damping_coef) {
-    this->node1 = node1;
-    this->node2 = node2;
-    this->spring_coef = spring_coef;
-    this->damping_coef = damping_coef;
+// Velocity change of node 1, node 2 gets the same change negated.
+static inline vec_t damping_vector(const vec_t &relative_p, const vec_t &relative_v, double damping_coef) {
+    // amount of damping varies a lot by time_step (makes sense, minus n-amount of velocity every 1 ms vs every 100ms, 100x difference)
+    vec_t r = project_vector(relative_v, relative_p);
+    return r * (damping_coef * 1/2);
+}
 
-    vector<double> p1 = this->node1->get_position();
-    vector<double> p2 = this->node2->get_position();
-    this->rest_length = vector_len(vector_sub(p2, p1));
+static inline uint64_t next_version() {
+    static atomic<uint64_t> last{0};
+    return last.fetch_add(1, memory_order_relaxed) + 1;
 }
 
-/*
-Edge::~Edge() {
-    // this segfaults
+uint EdgeTable::add(uint node1, uint node2, double spring_coef, double damping_coef, double rest_length) {
+    this->node1.push_back(node1);
+    this->node2.push_back(node2);
+    this->spring_coef.push_back(spring_coef);
+    this->damping_coef.push_back(damping_coef);
+    this->rest_length.push_back(rest_length);
+    this->deformation.push_back(0);
+    this->id.push_back(this->next_id++);
+    this->adjacency_valid = false;
+    this->coloring_valid = false;
+    this->version = next_version();
+
+    return this->node1.size() - 1;
+}
 
-    //delete[] this->node1;
-    //delete[] this->node2;
+uint EdgeTable::add(uint count) {
+    uint first = this->size();
+    uint n = first + count;
+    this->node1.resize(n);
+    this->node2.resize(n);
+    this->spring_coef.resize(n);
+    this->damping_coef.resize(n);
+    this->rest_length.resize(n);
+    this->deformation.resize(n);
+    this->id.resize(n);
+    for (uint i = first; i < n; i++)
+        this->id[i] = this->next_id++;
+    this->adjacency_valid = false;
+    this->coloring_valid = false;
+    this->version = next_version();
+
+    return first;
+}
 
-    delete this->node1;
-    delete this->node2;
+void EdgeTable::reserve(uint count) {
+    uint n = this->size() + count;
+    this->node1.reserve(n);
+    this->node2.reserve(n);
+    this->spring_coef.reserve(n);
+    this->damping_coef.reserve(n);
+    this->rest_length.reserve(n);
+    this->deformation.reserve(n);
+    this->id.reserve(n);
 }
-*/
 
-/*
-Edge::Edge(const Edge& e)
-    : spring_coef(e.spring_coef),
-    damping_coef(e.damping_coef), rest_length(e.rest_length)
-{
-    node1 = new Node(*e.node1);
-    node2 = new Node(*e.node1);
+uint EdgeTable::size() {
+    return this->node1.size();
 }
-*/
 
-void Edge::update_deformation() {
-    auto dist_vect = vector_sub(this->node2->get_position(), this->node1->get_position());
-    double spring_len = vector_len(dist_vect);
-    this->deformation = spring_len - this->rest_length;
+// Adds spring forces of edges [begin, end) to the nodes' force accumulators and applies damping to their velocities.
+// Edges deformed over deform_at keep part of the deformation, edges over tear_at are skipped.
+// Returns true if any edge should be torn.
+bool EdgeTable::apply_forces(NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at) {
+    bool tear = false;
+    for (uint i = begin; i < end; i++)
+    {
+        // tear edge
+        if (this->deformation[i] > tear_at)
+        {
+            tear = true;
+            continue;
+        }
+
+        // deform edge
+        if (this->deformation[i] > deform_at)
+            this->rest_length[i] += this->deformation[i];
+
+        uint n1 = this->node1[i];
+        uint n2 = this->node2[i];
+
+        // update spring f
+        vec_t relative_p = load(nodes->position, n2) - load(nodes->position, n1);
+        double distance = vector_len(relative_p);
+        this->deformation[i] = distance - this->rest_length[i];
+
+        vec_t f = spring_force(relative_p, distance, this->deformation[i], this->spring_coef[i]);
+        add_to(nodes->force, n1, f);
+        add_to(nodes->force, n2, -f);
+
+        // damping
+        vec_t relative_v = load(nodes->velocity, n2) - load(nodes->velocity, n1);
+        vec_t damp_v = damping_vector(relative_p, relative_v, this->damping_coef[i]);
+        add_to(nodes->velocity, n1, damp_v);
+        add_to(nodes->velocity, n2, -damp_v);
+    }
+
+    return tear;
 }
 
-pair<vector<double>, vector<double>> Edge::calculate_spring_force() {
-    update_deformation();
-    double magnitude = this->deformation * this->spring_coef;
+// Removes every edge deformed over tear_at, keeping the order of the remaining edges.
+void EdgeTable::remove_torn(double tear_at) {
+    uint kept = 0;
+    for (uint i = 0; i < this->size(); i++)
+    {
+        if (this->deformation[i] > tear_at)
+            continue;
+
+        this->node1[kept] = this->node1[i];
+        this->node2[kept] = this->node2[i];
+        this->spring_coef[kept] = this->spring_coef[i];
+        this->damping_coef[kept] = this->damping_coef[i];
+        this->rest_length[kept] = this->rest_length[i];
+        this->deformation[kept] = this->deformation[i];
+        this->id[kept] = this->id[i];
+        kept++;
+    }
 
-    vector<double> distance_vect = vector_sub(this->node2->get_position(), this->node1->get_position());
-    double distance = vector_len(distance_vect);
-    double scale_factor = 0;
+    this->node1.resize(kept);
+    this->node2.resize(kept);
+    this->spring_coef.resize(kept);
+    this->damping_coef.resize(kept);
+    this->rest_length.resize(kept);
+    this->deformation.resize(kept);
+    this->id.resize(kept);
+    this->adjacency_valid = false;
+    this->coloring_valid = false;
+    this->version = next_version();
+}
 
-    if (distance != 0) {
-        scale_factor = magnitude / distance;
+void EdgeTable::build_adjacency(uint node_count) {
+    // counting sort of edge endpoints by node
+    this->adjacency_start.assign(node_count + 1, 0);
+    for (uint i = 0; i < this->size(); i++)
+    {
+        this->adjacency_start[this->node1[i] + 1]++;
+        this->adjacency_start[this->node2[i] + 1]++;
+    }
+    for (uint n = 0; n < node_count; n++)
+        this->adjacency_start[n + 1] += this->adjacency_start[n];
+
+    this->adjacency.resize(2 * this->size());
+    vector<uint> fill_pos(this->adjacency_start.begin(), this->adjacency_start.end() - 1);
+    for (uint i = 0; i < this->size(); i++)
+    {
+        this->adjacency[fill_pos[this->node1[i]]++] = i;
+        this->adjacency[fill_pos[this->node2[i]]++] = i;
     }
+    this->adjacency_valid = true;
+}
 
-    vector<double> force_vect1 = scale_vector(distance_vect, scale_factor);
-    vector<double> force_vect2 = scale_vector(force_vect1, -1.0);
+// Greedy edge coloring, each edge gets the lowest color not used by another edge of either of its nodes.
+// Edges that would need more than 64 colors go to one last color that has to be evaluated serially.
+void EdgeTable::build_coloring(uint node_count) {
+    const uint max_colors = 64;
+    vector<uint64_t> used(node_count, 0);
+    vector<uint> color(this->size());
+    uint color_count = 0;
+    bool overflow = false;
+
+    for (uint i = 0; i < this->size(); i++)
+    {
+        uint64_t taken = used[this->node1[i]] | used[this->node2[i]];
+        if (taken == ~(uint64_t)0)
+        {
+            color[i] = max_colors;
+            overflow = true;
+            continue;
+        }
+
+        uint c = __builtin_ctzll(~taken);
+        used[this->node1[i]] |= (uint64_t)1 << c;
+        used[this->node2[i]] |= (uint64_t)1 << c;
+        color[i] = c;
+        color_count = max(color_count, c + 1);
+    }
 
-    return {force_vect1, force_vect2};
+    // counting sort by color, keeping the table order within a color
+    this->conflict_free_colors = color_count;
+    uint range_count = color_count + (overflow ? 1 : 0);
+    this->color_start.assign(range_count + 1, 0);
+    for (uint i = 0; i < this->size(); i++)
+        this->color_start[min(color[i], color_count) + 1]++;
+    for (uint c = 0; c < range_count; c++)
+        this->color_start[c + 1] += this->color_start[c];
+
+    vector<uint> order(this->size());
+    vector<uint> fill_pos(this->color_start.begin(), this->color_start.end() - 1);
+    for (uint i = 0; i < this->size(); i++)
+        order[fill_pos[min(color[i], color_count)]++] = i;
+
+    permute(order);
+    this->coloring_valid = true;
 }
 
-pair<vector<double>, vector<double>> Edge::calculate_damping_vectors() {
-    // amount of damping varies a lot by time_step (makes sense, minus n-amount of velocity every 1 ms vs every 100ms, 100x difference)
+// Reorders the edges so that the edge at index i is the one previously at order[i].
+void EdgeTable::permute(const vector<uint> &order) {
+    auto reorder = [&](auto &column) {
+        typename remove_reference<decltype(column)>::type reordered(column.size());
+        for (uint i = 0; i < order.size(); i++)
+            reordered[i] = move(column[order[i]]);
+        column.swap(reordered);
+    };
+
+    reorder(this->node1);
+    reorder(this->node2);
+    reorder(this->spring_coef);
+    reorder(this->damping_coef);
+    reorder(this->rest_length);
+    reorder(this->deformation);
+    reorder(this->id);
+    this->adjacency_valid = false;
+    this->version = next_version();
+}
 
-    auto p1 = this->node1->get_position();
-    auto p2 = this->node2->get_position();
-    auto v1 = this->node1->get_velocity();
-    auto v2 = this->node2->get_velocity();
+void EdgeTable::write(utils::BinaryWriter *out) {
+    out->write_array(this->node1);
+    out->write_array(this->node2);
+    out->write_array(this->spring_coef);
+    out->write_array(this->damping_coef);
+    out->write_array(this->rest_length);
+    out->write_array(this->deformation);
+    out->write_array(this->id);
+    out->write(this->next_id);
+    out->write(this->coloring_valid);
+    out->write(this->conflict_free_colors);
+    out->write_array(this->color_start);
+}
+
+bool EdgeTable::read(utils::BinaryReader *in, uint node_count) {
+    in->read_array(&this->node1);
+    in->read_array(&this->node2);
+    in->read_array(&this->spring_coef);
+    in->read_array(&this->damping_coef);
+    in->read_array(&this->rest_length);
+    in->read_array(&this->deformation);
+    in->read_array(&this->id);
+    in->read(&this->next_id);
+    in->read(&this->coloring_valid);
+    in->read(&this->conflict_free_colors);
+    in->read_array(&this->color_start);
+    this->adjacency_valid = false;
+    this->version = next_version();
+    if (!in->good())
+        return false;
+
+    uint n = this->size();
+    if (this->node2.size() != n || this->spring_coef.size() != n || this->damping_coef.size() != n
+        || this->rest_length.size() != n || this->deformation.size() != n || this->id.size() != n)
+        return false;
+    for (uint i = 0; i < n; i++)
+        if (this->node1[i] >= node_count || this->node2[i] >= node_count)
+            return false;
+    if (this->coloring_valid && (this->color_start.empty() || this->color_start.back() != n))
+        return false;
+    return true;
+}
+
+Edge::Edge() = default;
+Edge::Edge(EdgeTable *table, NodeStore *nodes, uint index) {
+    this->table = table;
+    this->nodes = nodes;
+    this->index = index;
+}
+
+void Edge::update_deformation() {
+    vec_t dist_vect = get_node2().get_position() - get_node1().get_position();
+    double spring_len = vector_len(dist_vect);
+    this->table->deformation[this->index] = spring_len - this->table->rest_length[this->index];
+}
+
+pair<vec_t, vec_t> Edge::calculate_spring_force() {
+    vec_t distance_vect = get_node2().get_position() - get_node1().get_position();
+    double distance = vector_len(distance_vect);
+    double deformation = distance - this->table->rest_length[this->index];
+    this->table->deformation[this->index] = deformation;
+
+    vec_t force_vect1 = spring_force(distance_vect, distance, deformation, this->table->spring_coef[this->index]);
+    vec_t force_vect2 = -force_vect1;
+
+    return {force_vect1, force_vect2};
+}
 
-    vector<double> relative_p = vector_sub(p2, p1);
-    vector<double> relative_v = vector_sub(v2, v1);
+pair<vec_t, vec_t> Edge::calculate_damping_vectors() {
+    vec_t relative_p = get_node2().get_position() - get_node1().get_position();
+    vec_t relative_v = get_node2().get_velocity() - get_node1().get_velocity();
 
-    auto r = project_vector(relative_v, relative_p);
-    auto damp_v1 = scale_vector(r, this->damping_coef * 1/2);
-    auto damp_v2 = scale_vector(damp_v1, -1.);
+    vec_t damp_v1 = damping_vector(relative_p, relative_v, this->table->damping_coef[this->index]);
+    vec_t damp_v2 = -damp_v1;
 
     return {damp_v1, damp_v2};
 }
 
 void Edge::set_rest_length(double new_rest_length) {
-    this->rest_length = new_rest_length;
+    this->table->rest_length[this->index] = new_rest_length;
 }
 
-Node* Edge::get_node1() {
-    return this->node1;
+Node Edge::get_node1() {
+    return Node(this->nodes, this->table->node1[this->index]);
 }
 
-Node* Edge::get_node2() {
-    return this->node2;
+Node Edge::get_node2() {
+    return Node(this->nodes, this->table->node2[this->index]);
 }
 
 double Edge::get_spring_coef() {
-    return this->spring_coef;
+    return this->table->spring_coef[this->index];
 }
 
 double Edge::get_damping_coef() {
-    return this->damping_coef;
+    return this->table->damping_coef[this->index];
 }
 
 double Edge::get_deformation() {
-    return this->deformation;
+    return this->table->deformation[this->index];
 }
 
 double Edge::get_rest_length() {
-    return this->rest_length;
+    return this->table->rest_length[this->index];
 }
 
-void Edge::set_id(string id) {
-    this->id = id;
+uint Edge::get_index() {
+    return this->index;
 }
 
-string Edge::get_edge_id() {
-    return this->id;
+uint Edge::get_edge_id() {
+    return this->table->id[this->index];
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -6,44 +6,85 @@
 
 using namespace std;
 
+// Topology and spring parameters of every edge of a body, stored as one contiguous array per field.
+// Edges refer to nodes by their index in the body's NodeStore.
+class EdgeTable {
+    public:
+        vector<uint> node1;
+        vector<uint> node2;
+        vector<double> spring_coef;
+        vector<double> damping_coef;
+        vector<double> rest_length;
+        vector<double> deformation;
+        // id used for distinguishing between other edges of the table, handed out in order from next_id and kept
+        // when edges are reordered or removed
+        vector<uint> id;
+        uint next_id = 0;
+
+        // node to edge adjacency in compressed sparse row form, the edges of node i are
+        // adjacency[adjacency_start[i]] up to adjacency[adjacency_start[i + 1]]
+        vector<uint> adjacency_start;
+        vector<uint> adjacency;
+        bool adjacency_valid = false;
+
+        // edges are reordered so that each color is the contiguous range color_start[c] up to color_start[c + 1]
+        // and no two edges of a color share a node. Colors past conflict_free_colors may share nodes.
+        vector<uint> color_start;
+        uint conflict_free_colors = 0;
+        bool coloring_valid = false;
+
+        // changes whenever edges are added, removed or reordered. Versions come from one counter shared by every
+        // table, so a table copied from a snapshot has the version of the edges it was copied with.
+        uint64_t version = 0;
+
+        uint add(uint node1, uint node2, double spring_coef, double damping_coef, double rest_length);
+        // appends count edges with their ids and every other field zero, returns the index of the first
+        uint add(uint count);
+        // makes room for count more edges, so adding them doesn't reallocate
+        void reserve(uint count);
+        uint size();
+
+        bool apply_forces(NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at);
+        void remove_torn(double tear_at);
+        void build_adjacency(uint node_count);
+        void build_coloring(uint node_count);
+        void permute(const vector<uint> &order);
+
+        // columns, ids and coloring, see Simulator::save_checkpoint. The coloring is kept because coloring the
+        // reordered edges again could order the force sums differently. read fails on columns of different lengths
+        // or edges of nodes past node_count.
+        void write(utils::BinaryWriter *out);
+        bool read(utils::BinaryReader *in, uint node_count);
+};
+
+// Lightweight handle to one edge inside an EdgeTable.
 class Edge {
     private:
-        Node* node1;
-        Node* node2;
-        double spring_coef;
-        double damping_coef;
-        double rest_length;
-        double deformation = 0;
-        string id;
+        EdgeTable *table = NULL;
+        NodeStore *nodes = NULL;
+        uint index = 0;
 
     public:
         Edge();
-
-        Edge(Node node1, Node node2, double spring_coef, double damping_coef, double rest_length);
-        // if rest_length not given, set rest_length as the current distance of nodes 1 and 2.
-        Edge(Node node1, Node node2, double spring_coef, double damping_coef);
-        Edge(Node *node1, Node *node2, double spring_coef, double damping_coef);
-
-        //~Edge();
-        //Edge(const Edge &e);
+        Edge(EdgeTable *table, NodeStore *nodes, uint index);
 
         void update_deformation();
 
-        pair<vector<double>, vector<double>> calculate_spring_force();
-        pair<vector<double>, vector<double>> calculate_damping_vectors();
+        pair<vec_t, vec_t> calculate_spring_force();
+        pair<vec_t, vec_t> calculate_damping_vectors();
 
         void set_rest_length(double new_rest_length);
 
-        Node *get_node1();
-        Node *get_node2();
+        Node get_node1();
+        Node get_node2();
         double get_spring_coef();
         double get_damping_coef();
         double get_deformation();
         double get_rest_length();
+        uint get_index();
 
-        // id used for distinguishing between other edges, e.g. when there are multiple spring/edge forces acting on one node.
-        void set_id(string id);
-        string get_edge_id();
+        // id used for distinguishing between other edges of the body
+        uint get_edge_id();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,377 @@
+#include <bits/stdc++.h>
+#include "../utils/vectors.cpp"
+
+#include "node.h"
+#include "edge.h"
+
+#ifndef SOFTBODY_IMPLICIT_SOLVER_CC_
+#define SOFTBODY_IMPLICIT_SOLVER_CC_
+
+using namespace std;
+
+// Backward Euler step for springs, solved matrix-free with block Jacobi preconditioned conjugate gradient.
+//
+// With h the time step, K = dF/dx the spring stiffness and D = dF/dv the damping, the new velocities solve
+//     (M - h D - h^2 K) v_new = M v + h F
+// where F holds the spring, slot and external forces at the current positions. Each edge contributes the block
+//     A_e = iso * I + aniso * u u^T
+// to the rows of its two nodes, u being the edge direction. The part of K that would make A indefinite under
+// compression is dropped, so A stays symmetric positive definite for positive masses.
+//
+// The matrix is never built: the per-edge coefficients are kept and the product with A is evaluated over the
+// edges, one color of the edge coloring at a time like the explicit force pass. The preconditioner is the inverse
+// of the DIMENSIONS x DIMENSIONS diagonal block of every node, aniso terms included, so it undoes the stiffness
+// along the edges of a node and not only its axis aligned part.
+class ImplicitSolver {
+    public:
+        // CG stops once the residual is this fraction of the residual of the initial guess, the old velocities
+        double tolerance = 1e-2;
+        uint max_iterations = 200;
+
+        // statistics of the last solve
+        uint last_iterations = 0;
+        double last_residual = 0;
+
+        // per edge unit direction and block coefficients
+        vector<double> direction[DIMENSIONS];
+        vector<double> iso;
+        vector<double> aniso;
+
+        // per node solver vectors, x is the solution (the new velocities)
+        vector<double> x[DIMENSIONS];
+        vector<double> r[DIMENSIONS];
+        vector<double> z[DIMENSIONS];
+        vector<double> p[DIMENSIONS];
+        vector<double> q[DIMENSIONS];
+        // diagonal block of every node of A while assembling, its inverse during the solve, entry (a, b) of the
+        // block of node i is preconditioner[a * DIMENSIONS + b][i]
+        vector<double> preconditioner[DIMENSIONS * DIMENSIONS];
+
+        // sizes the scratch arrays, only allocates when the body grew
+        void resize(uint node_count, uint edge_count)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                this->direction[d].resize(edge_count);
+                this->x[d].resize(node_count);
+                this->r[d].resize(node_count);
+                this->z[d].resize(node_count);
+                this->p[d].resize(node_count);
+                this->q[d].resize(node_count);
+            }
+            for (uint k = 0; k < DIMENSIONS * DIMENSIONS; k++)
+                this->preconditioner[k].resize(node_count);
+            this->iso.resize(edge_count);
+            this->aniso.resize(edge_count);
+        }
+
+        // Prepares nodes [begin, end): clears the force accumulators and starts the diagonal blocks of A at M.
+        void begin_nodes(NodeStore *nodes, uint begin, uint end)
+        {
+            nodes->clear_forces(begin, end);
+            for (uint a = 0; a < DIMENSIONS; a++)
+                for (uint b = 0; b < DIMENSIONS; b++)
+                    for (uint i = begin; i < end; i++)
+                        this->preconditioner[a * DIMENSIONS + b][i] = a == b ? nodes->mass[i] : 0;
+        }
+
+        // Inverts the diagonal block of node i in place by Gauss-Jordan elimination, the block is symmetric
+        // positive definite so no pivoting is needed.
+        void invert_block(uint i)
+        {
+            double m[DIMENSIONS][DIMENSIONS], inv[DIMENSIONS][DIMENSIONS];
+            for (uint a = 0; a < DIMENSIONS; a++)
+                for (uint b = 0; b < DIMENSIONS; b++)
+                {
+                    m[a][b] = this->preconditioner[a * DIMENSIONS + b][i];
+                    inv[a][b] = a == b;
+                }
+            for (uint c = 0; c < DIMENSIONS; c++)
+            {
+                double scale = 1 / m[c][c];
+                for (uint b = 0; b < DIMENSIONS; b++)
+                {
+                    m[c][b] *= scale;
+                    inv[c][b] *= scale;
+                }
+                for (uint a = 0; a < DIMENSIONS; a++)
+                {
+                    if (a == c)
+                        continue;
+                    double f = m[a][c];
+                    for (uint b = 0; b < DIMENSIONS; b++)
+                    {
+                        m[a][b] -= f * m[c][b];
+                        inv[a][b] -= f * inv[c][b];
+                    }
+                }
+            }
+            for (uint a = 0; a < DIMENSIONS; a++)
+                for (uint b = 0; b < DIMENSIONS; b++)
+                    this->preconditioner[a * DIMENSIONS + b][i] = inv[a][b];
+        }
+
+        // z = P^-1 r over nodes [begin, end)
+        void precondition(uint begin, uint end)
+        {
+            const double *block[DIMENSIONS * DIMENSIONS], *r[DIMENSIONS];
+            double *z[DIMENSIONS];
+            for (uint k = 0; k < DIMENSIONS * DIMENSIONS; k++)
+                block[k] = this->preconditioner[k].data();
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                r[d] = this->r[d].data();
+                z[d] = this->z[d].data();
+            }
+            for (uint i = begin; i < end; i++)
+                for (uint a = 0; a < DIMENSIONS; a++)
+                {
+                    double sum = 0;
+                    for (uint b = 0; b < DIMENSIONS; b++)
+                        sum += block[a * DIMENSIONS + b][i] * r[b][i];
+                    z[a][i] = sum;
+                }
+        }
+
+        // Adds the spring forces of edges [begin, end) to the node accumulators and stores the edges' blocks of A.
+        // Deformation and tearing work like EdgeTable::apply_forces. Returns true if any edge should be torn.
+        bool assemble(NodeStore *nodes, EdgeTable *edges, uint begin, uint end, double h, double deform_at, double tear_at)
+        {
+            const uint *node1 = edges->node1.data(), *node2 = edges->node2.data();
+            const double *spring_coef = edges->spring_coef.data(), *damping_coef = edges->damping_coef.data();
+            double *rest_length = edges->rest_length.data(), *deformation = edges->deformation.data();
+            const double *inv_mass = nodes->inv_mass.data();
+            double *iso = this->iso.data(), *aniso = this->aniso.data();
+            const double *position[DIMENSIONS];
+            double *force[DIMENSIONS], *u[DIMENSIONS], *block[DIMENSIONS * DIMENSIONS];
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                position[d] = nodes->position[d].data();
+                force[d] = nodes->force[d].data();
+                u[d] = this->direction[d].data();
+            }
+            for (uint k = 0; k < DIMENSIONS * DIMENSIONS; k++)
+                block[k] = this->preconditioner[k].data();
+
+            bool tear = false;
+            for (uint i = begin; i < end; i++)
+            {
+                iso[i] = 0;
+                aniso[i] = 0;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                    u[d][i] = 0;
+
+                // tear edge
+                if (deformation[i] > tear_at)
+                {
+                    tear = true;
+                    continue;
+                }
+
+                // deform edge
+                if (deformation[i] > deform_at)
+                    rest_length[i] += deformation[i];
+
+                uint n1 = node1[i];
+                uint n2 = node2[i];
+
+                double relative_p[DIMENSIONS];
+                double distance_sq = 0;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    relative_p[d] = position[d][n2] - position[d][n1];
+                    distance_sq += relative_p[d] * relative_p[d];
+                }
+                double distance = sqrt(distance_sq);
+                double rest = rest_length[i];
+                double k = spring_coef[i];
+                deformation[i] = distance - rest;
+                if (distance == 0)
+                    continue;
+
+                double inv_distance = 1 / distance;
+                double scale = deformation[i] * k * inv_distance;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    double f = relative_p[d] * scale;
+                    force[d][n1] += f;
+                    force[d][n2] -= f;
+                    u[d][i] = relative_p[d] * inv_distance;
+                }
+
+                // the damping coefficient keeps its meaning from the explicit step, the share of the relative
+                // velocity along the edge removed per step, as a dashpot on the pair's reduced mass
+                double reduced_mass = 1 / (inv_mass[n1] + inv_mass[n2]);
+                double transverse = k * max(0., 1 - rest * inv_distance);
+                iso[i] = h * h * transverse;
+                aniso[i] = h * h * (k - transverse) + damping_coef[i] * reduced_mass;
+
+                for (uint a = 0; a < DIMENSIONS; a++)
+                    for (uint b = 0; b < DIMENSIONS; b++)
+                    {
+                        double entry = (a == b ? iso[i] : 0) + aniso[i] * u[a][i] * u[b][i];
+                        block[a * DIMENSIONS + b][n1] += entry;
+                        block[a * DIMENSIONS + b][n2] += entry;
+                    }
+            }
+            return tear;
+        }
+
+        // Sets up nodes [begin, end) for CG: adds slot and external forces to the accumulators, stores
+        // b = M v + h F in r, starts x at the current velocity with q = M x and inverts the preconditioner.
+        void begin_solve(NodeStore *nodes, uint begin, uint end, double h, vec_t external_force)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                double *f = nodes->force[d].data();
+                const double *v = nodes->velocity[d].data();
+                const double *m = nodes->mass.data();
+                for (uint i = begin; i < end; i++)
+                {
+                    for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+                        f[i] += nodes->slot_force[s][d][i];
+                    f[i] += external_force[d];
+
+                    this->r[d][i] = m[i] * v[i] + h * f[i];
+                    this->x[d][i] = v[i];
+                    this->q[d][i] = m[i] * v[i];
+                }
+            }
+            for (uint i = begin; i < end; i++)
+                invert_block(i);
+        }
+
+        // out += (sum of the edge blocks) * in over edges [begin, end), the edges must not share nodes
+        // unless they run on one thread
+        void multiply_edges(const EdgeTable *edges, vector<double> (&in)[DIMENSIONS], vector<double> (&out)[DIMENSIONS], uint begin, uint end)
+        {
+            const uint *node1 = edges->node1.data(), *node2 = edges->node2.data();
+            const double *iso = this->iso.data(), *aniso = this->aniso.data();
+            const double *u[DIMENSIONS], *in_d[DIMENSIONS];
+            double *out_d[DIMENSIONS];
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                u[d] = this->direction[d].data();
+                in_d[d] = in[d].data();
+                out_d[d] = out[d].data();
+            }
+
+            for (uint i = begin; i < end; i++)
+            {
+                uint n1 = node1[i];
+                uint n2 = node2[i];
+
+                double dp[DIMENSIONS];
+                double along = 0;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    dp[d] = in_d[d][n1] - in_d[d][n2];
+                    along += dp[d] * u[d][i];
+                }
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    double w = iso[i] * dp[d] + aniso[i] * along * u[d][i];
+                    out_d[d][n1] += w;
+                    out_d[d][n2] -= w;
+                }
+            }
+        }
+
+        // r = b - A x, z = P^-1 r, p = z and q = M p over nodes [begin, end), q holds A x
+        void initial_residual(const NodeStore *nodes, uint begin, uint end)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+                for (uint i = begin; i < end; i++)
+                    this->r[d][i] -= this->q[d][i];
+            precondition(begin, end);
+            for (uint d = 0; d < DIMENSIONS; d++)
+                for (uint i = begin; i < end; i++)
+                {
+                    this->p[d][i] = this->z[d][i];
+                    this->q[d][i] = nodes->mass[i] * this->p[d][i];
+                }
+        }
+
+        // x += alpha p, r -= alpha q and z = P^-1 r over nodes [begin, end), then r.z and r.r of the range like
+        // residual_dots
+        void update_solution(double alpha, uint begin, uint end, double *rz, double *rr)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                double *x = this->x[d].data(), *r = this->r[d].data();
+                const double *p = this->p[d].data(), *q = this->q[d].data();
+                for (uint i = begin; i < end; i++)
+                {
+                    x[i] += alpha * p[i];
+                    r[i] -= alpha * q[i];
+                }
+            }
+            precondition(begin, end);
+            residual_dots(begin, end, rz, rr);
+        }
+
+        // p = z + beta p and q = M p over nodes [begin, end), the edge part of A p is added by multiply_edges
+        void update_direction(const NodeStore *nodes, double beta, uint begin, uint end)
+        {
+            const double *m = nodes->mass.data();
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                double *p = this->p[d].data(), *q = this->q[d].data();
+                const double *z = this->z[d].data();
+                for (uint i = begin; i < end; i++)
+                {
+                    p[i] = z[i] + beta * p[i];
+                    q[i] = m[i] * p[i];
+                }
+            }
+        }
+
+        double dot(vector<double> (&a)[DIMENSIONS], vector<double> (&b)[DIMENSIONS], uint begin, uint end)
+        {
+            double sum = 0;
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                const double *a_d = a[d].data(), *b_d = b[d].data();
+                for (uint i = begin; i < end; i++)
+                    sum += a_d[i] * b_d[i];
+            }
+            return sum;
+        }
+
+        // r.z and r.r in one pass
+        void residual_dots(uint begin, uint end, double *rz, double *rr)
+        {
+            double sum_rz = 0, sum_rr = 0;
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                const double *r = this->r[d].data(), *z = this->z[d].data();
+                for (uint i = begin; i < end; i++)
+                {
+                    sum_rz += r[i] * z[i];
+                    sum_rr += r[i] * r[i];
+                }
+            }
+            *rz = sum_rz;
+            *rr = sum_rr;
+        }
+
+        // Moves nodes [begin, end) with the solved velocities, the acceleration is the velocity change over the step.
+        void finish_nodes(NodeStore *nodes, uint begin, uint end, double h)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                double *p = nodes->position[d].data();
+                double *v = nodes->velocity[d].data();
+                double *a = nodes->acceleration[d].data();
+                for (uint i = begin; i < end; i++)
+                {
+                    double new_v = this->x[d][i];
+                    a[i] = (new_v - v[i]) / h;
+                    v[i] = new_v;
+                    p[i] += new_v * h;
+                }
+            }
+        }
+};
+
+#endif
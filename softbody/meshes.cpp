@@ -0,0 +1,277 @@
+#include <bits/stdc++.h>
+#include "../utils/vectors.cpp"
+
+#include "softbody.h"
+#include "meshes.h"
+
+#ifndef SOFTBODY_MESHES_CC_
+#define SOFTBODY_MESHES_CC_
+
+using namespace std;
+
+namespace meshes {
+    // count - step, or 0 if that would be negative
+    static inline uint past(uint count, uint step)
+    {
+        return count > step ? count - step : 0;
+    }
+
+    // Builders append all their nodes and edges at once and fill in the arrays directly, Builder writes one
+    // edge after the other with its current length as rest length.
+    struct Builder
+    {
+        NodeStore *nodes;
+        EdgeTable *edges;
+        double spring_coef;
+        double damping_coef;
+        uint next_edge;
+
+        Builder(SoftBody *sb, uint edge_count, double spring_coef, double damping_coef)
+        {
+            this->nodes = sb->get_nodes();
+            this->edges = sb->get_edges();
+            this->spring_coef = spring_coef;
+            this->damping_coef = damping_coef;
+            this->next_edge = sb->add_edges(edge_count);
+        }
+
+        void set_position(uint node, double x, double y)
+        {
+            this->nodes->position[0][node] = x;
+            this->nodes->position[1][node] = y;
+        }
+
+        void add_edge(uint node1, uint node2)
+        {
+            uint e = this->next_edge++;
+            double length_sq = 0;
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                double delta = this->nodes->position[d][node2] - this->nodes->position[d][node1];
+                length_sq += delta * delta;
+            }
+            this->edges->node1[e] = node1;
+            this->edges->node2[e] = node2;
+            this->edges->spring_coef[e] = this->spring_coef;
+            this->edges->damping_coef[e] = this->damping_coef;
+            this->edges->rest_length[e] = sqrt(length_sq);
+        }
+    };
+
+    uint build_grid(SoftBody *sb, vec_t origin, uint w, uint h, double spacing, double mass, double spring_coef, double damping_coef, uint springs)
+    {
+        uint edge_count = 0;
+        if (springs & GRID_STRUCTURAL)
+            edge_count += past(w, 1) * h + w * past(h, 1);
+        if (springs & GRID_SHEAR)
+            edge_count += 2 * past(w, 1) * past(h, 1);
+        if (springs & GRID_BEND)
+            edge_count += past(w, 2) * h + w * past(h, 2);
+
+        uint first = sb->add_nodes(w * h, mass);
+        Builder b(sb, edge_count, spring_coef, damping_coef);
+        for (uint y = 0; y < h; y++)
+            for (uint x = 0; x < w; x++)
+                b.set_position(first + y * w + x, origin[0] + x * spacing, origin[1] + y * spacing);
+
+        auto at = [&](uint x, uint y) { return first + y * w + x; };
+        for (uint y = 0; y < h; y++)
+        {
+            for (uint x = 0; x < w; x++)
+            {
+                if ((springs & GRID_STRUCTURAL) && x + 1 < w)
+                    b.add_edge(at(x, y), at(x + 1, y));
+                if ((springs & GRID_STRUCTURAL) && y + 1 < h)
+                    b.add_edge(at(x, y), at(x, y + 1));
+                if ((springs & GRID_SHEAR) && x + 1 < w && y + 1 < h)
+                {
+                    b.add_edge(at(x, y), at(x + 1, y + 1));
+                    b.add_edge(at(x + 1, y), at(x, y + 1));
+                }
+                if ((springs & GRID_BEND) && x + 2 < w)
+                    b.add_edge(at(x, y), at(x + 2, y));
+                if ((springs & GRID_BEND) && y + 2 < h)
+                    b.add_edge(at(x, y), at(x, y + 2));
+            }
+        }
+        return first;
+    }
+
+    uint build_ring(SoftBody *sb, vec_t center, double radius, uint segments, double mass, double spring_coef, double damping_coef)
+    {
+        // with fewer segments the nodes two away are already neighbours or the same node
+        bool bend = segments >= 5;
+        uint neighbour_edges = segments < 2 ? 0 : segments == 2 ? 1 : segments;
+
+        uint first = sb->add_nodes(segments, mass);
+        Builder b(sb, neighbour_edges + (bend ? segments : 0), spring_coef, damping_coef);
+        for (uint i = 0; i < segments; i++)
+        {
+            double angle = 2 * M_PI * i / segments;
+            b.set_position(first + i, center[0] + radius * cos(angle), center[1] + radius * sin(angle));
+        }
+        for (uint i = 0; i < neighbour_edges; i++)
+            b.add_edge(first + i, first + (i + 1) % segments);
+        if (bend)
+            for (uint i = 0; i < segments; i++)
+                b.add_edge(first + i, first + (i + 2) % segments);
+        return first;
+    }
+
+    // Calls emit(node1, node2) for every edge of a disk whose center is node 0 and whose ring r (from 1) has 6r
+    // nodes starting at node 1 + 3r(r - 1). Neighbouring rings are zipped together: walking around both at once
+    // and always advancing the ring whose next node comes at the smaller angle gives one triangle per step.
+    template <typename _F>
+    static void disk_edges(uint rings, const _F &emit)
+    {
+        for (uint r = 1; r <= rings; r++)
+        {
+            uint inner_start = r == 1 ? 0 : 1 + 3 * (r - 1) * (r - 2), inner_count = r == 1 ? 1 : 6 * (r - 1);
+            uint outer_start = 1 + 3 * r * (r - 1), outer_count = 6 * r;
+
+            for (uint k = 0; k < outer_count; k++)
+                emit(outer_start + k, outer_start + (k + 1) % outer_count);
+
+            if (r == 1)
+            {
+                for (uint k = 0; k < outer_count; k++)
+                    emit(0, outer_start + k);
+                continue;
+            }
+
+            uint i = 0, k = 0;
+            emit(inner_start, outer_start);
+            for (uint step = 1; step < inner_count + outer_count; step++)
+            {
+                // compare (i + 1) / inner_count with (k + 1) / outer_count without rounding
+                if ((uint64_t)(i + 1) * outer_count <= (uint64_t)(k + 1) * inner_count)
+                    i++;
+                else
+                    k++;
+                emit(inner_start + i % inner_count, outer_start + k % outer_count);
+            }
+        }
+    }
+
+    uint build_disk(SoftBody *sb, vec_t center, double radius, uint rings, double mass, double spring_coef, double damping_coef)
+    {
+        // ring r adds 6r nodes and 18r - 6 edges, 6r around it and 6(r - 1) + 6r to the ring inside
+        uint node_count = 1 + 3 * rings * (rings + 1);
+        uint edge_count = 9 * rings * rings + 3 * rings;
+
+        uint first = sb->add_nodes(node_count, mass);
+        Builder b(sb, edge_count, spring_coef, damping_coef);
+        b.set_position(first, center[0], center[1]);
+        for (uint r = 1; r <= rings; r++)
+        {
+            double ring_radius = radius * r / rings;
+            uint ring_start = first + 1 + 3 * r * (r - 1);
+            for (uint k = 0; k < 6 * r; k++)
+            {
+                double angle = 2 * M_PI * k / (6 * r);
+                b.set_position(ring_start + k, center[0] + ring_radius * cos(angle), center[1] + ring_radius * sin(angle));
+            }
+        }
+        disk_edges(rings, [&](uint n1, uint n2) { b.add_edge(first + n1, first + n2); });
+        return first;
+    }
+
+    uint build_rope(SoftBody *sb, vec_t start, vec_t end, uint segments, double mass, double spring_coef, double damping_coef)
+    {
+        uint first = sb->add_nodes(segments + 1, mass);
+        Builder b(sb, segments + past(segments, 1), spring_coef, damping_coef);
+        vec_t step = (end - start) * (1. / max(segments, 1u));
+        for (uint i = 0; i <= segments; i++)
+            b.set_position(first + i, start[0] + step[0] * i, start[1] + step[1] * i);
+        for (uint i = 0; i < segments; i++)
+            b.add_edge(first + i, first + i + 1);
+        for (uint i = 0; i + 2 <= segments; i++)
+            b.add_edge(first + i, first + i + 2);
+        return first;
+    }
+
+    // even-odd rule, a ray from p to the right crosses the outline an odd number of times if p is inside
+    static bool inside_polygon(const vector<vec_t> &outline, double x, double y)
+    {
+        bool inside = false;
+        for (uint i = 0, j = outline.size() - 1; i < outline.size(); j = i++)
+        {
+            const vec_t &a = outline[i], &b = outline[j];
+            if ((a[1] > y) != (b[1] > y) && x < (b[0] - a[0]) * (y - a[1]) / (b[1] - a[1]) + a[0])
+                inside = !inside;
+        }
+        return inside;
+    }
+
+    uint build_polygon(SoftBody *sb, const vector<vec_t> &outline, double spacing, double mass, double spring_coef, double damping_coef)
+    {
+        if (outline.size() < 3 || spacing <= 0)
+            return sb->get_nodes()->size();
+
+        vec_t low = outline[0], high = outline[0];
+        for (const vec_t &p : outline)
+            for (uint d = 0; d < 2; d++)
+            {
+                low[d] = min(low[d], p[d]);
+                high[d] = max(high[d], p[d]);
+            }
+
+        // odd rows are shifted by half a spacing, every node has 6 neighbours at spacing
+        double row_height = spacing * sqrt(3) / 2;
+        uint columns = (high[0] - low[0]) / spacing + 2;
+        uint rows = (high[1] - low[1]) / row_height + 1;
+        auto x_of = [&](uint r, uint c) { return low[0] + c * spacing + (r % 2 ? spacing / 2 : 0); };
+        auto y_of = [&](uint r) { return low[1] + r * row_height; };
+
+        // node of every lattice point, -1 outside
+        vector<int> node_of((size_t)rows * columns, -1);
+        uint node_count = 0;
+        for (uint r = 0; r < rows; r++)
+            for (uint c = 0; c < columns; c++)
+                if (inside_polygon(outline, x_of(r, c), y_of(r)))
+                    node_of[(size_t)r * columns + c] = node_count++;
+
+        // lattice edges going right and to the next row, at most 3 per node
+        vector<pair<uint, uint>> lattice_edges;
+        lattice_edges.reserve((size_t)node_count * 3);
+        auto try_edge = [&](uint r1, uint c1, uint r2, uint c2) {
+            if (r2 >= rows || c2 >= columns)
+                return;
+            int n1 = node_of[(size_t)r1 * columns + c1], n2 = node_of[(size_t)r2 * columns + c2];
+            if (n1 < 0 || n2 < 0)
+                return;
+            if (!inside_polygon(outline, (x_of(r1, c1) + x_of(r2, c2)) / 2, (y_of(r1) + y_of(r2)) / 2))
+                return;
+            lattice_edges.push_back({n1, n2});
+        };
+        for (uint r = 0; r < rows; r++)
+            for (uint c = 0; c < columns; c++)
+            {
+                try_edge(r, c, r, c + 1);
+                // even rows reach the next row at c - 1 and c, odd rows at c and c + 1
+                if (r % 2)
+                {
+                    try_edge(r, c, r + 1, c);
+                    try_edge(r, c, r + 1, c + 1);
+                }
+                else
+                {
+                    if (c > 0)
+                        try_edge(r, c, r + 1, c - 1);
+                    try_edge(r, c, r + 1, c);
+                }
+            }
+
+        uint first = sb->add_nodes(node_count, mass);
+        Builder b(sb, lattice_edges.size(), spring_coef, damping_coef);
+        for (uint r = 0; r < rows; r++)
+            for (uint c = 0; c < columns; c++)
+                if (node_of[(size_t)r * columns + c] >= 0)
+                    b.set_position(first + node_of[(size_t)r * columns + c], x_of(r, c), y_of(r));
+        for (const pair<uint, uint> &e : lattice_edges)
+            b.add_edge(first + e.first, first + e.second);
+        return first;
+    }
+}
+
+#endif
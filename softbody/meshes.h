@@ -0,0 +1,42 @@
+#include <bits/stdc++.h>
+#include "softbody.h"
+
+#ifndef SOFTBODY_MESHES_H_
+#define SOFTBODY_MESHES_H_
+
+using namespace std;
+
+// Builders of common bodies. Each appends all its nodes and all its edges to a body at once, so the storage grows
+// exactly once, works in time linear in the number of nodes and returns the index of its first node. Every node
+// gets the given mass, every edge the given coefficients and its current length as rest length.
+namespace meshes {
+    // springs of build_grid
+    enum grid_springs {
+        // to the next node right and down
+        GRID_STRUCTURAL = 1,
+        // along both diagonals of every cell
+        GRID_SHEAR = 2,
+        // to the node two to the right and two down, resists folding
+        GRID_BEND = 4
+    };
+
+    // w x h nodes spacing apart, row by row starting at origin
+    uint build_grid(SoftBody *sb, vec_t origin, uint w, uint h, double spacing, double mass, double spring_coef, double damping_coef, uint springs);
+
+    // closed loop of segments nodes on a circle, each node is connected to its neighbours and, with 5 or more
+    // segments, to the nodes two away
+    uint build_ring(SoftBody *sb, vec_t center, double radius, uint segments, double mass, double spring_coef, double damping_coef);
+
+    // filled circle, a center node and rings concentric rings of 6, 12, 18, ... nodes, triangulated between
+    // neighbouring rings
+    uint build_disk(SoftBody *sb, vec_t center, double radius, uint rings, double mass, double spring_coef, double damping_coef);
+
+    // chain of segments + 1 nodes from start to end, each node is connected to its neighbours and the nodes two away
+    uint build_rope(SoftBody *sb, vec_t start, vec_t end, uint segments, double mass, double spring_coef, double damping_coef);
+
+    // the inside of a simple polygon filled with a triangular lattice of spacing apart nodes. Lattice edges that
+    // would cross the outside, in a concave part, are left out.
+    uint build_polygon(SoftBody *sb, const vector<vec_t> &outline, double spacing, double mass, double spring_coef, double damping_coef);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include <bits/stdc++.h>
 
 #include "../utils/vectors.cpp"
+#include "../utils/binary_file.cpp"
 
 #include "./node.h"
 
@@ -10,91 +11,239 @@
 using namespace std;
 using namespace utils::vectors;
 
-Node::Node() = default;
-Node::Node(vector<double> position, double mass)
+uint NodeStore::add(vec_t position, double mass)
+{
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        this->position[d].push_back(position[d]);
+        this->velocity[d].push_back(0);
+        this->acceleration[d].push_back(0);
+        this->force[d].push_back(0);
+        for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+            this->slot_force[s][d].push_back(0);
+    }
+    this->mass.push_back(mass);
+    this->inv_mass.push_back(1.0 / mass);
+
+    return this->mass.size() - 1;
+}
+
+uint NodeStore::add(uint count, double mass)
 {
-    this->mass = mass;
-    this->acceleration = vector<double>();
-    this->velocity = vector<double>();
-    this->position = position;
-    //init velocity and acceleration as 0 vectors. Determine the number of dimensions from position given as argument
-    for (uint i = 0; i < this->position.size(); i++) {
-        this->velocity.push_back(0);
-        this->acceleration.push_back(0);
+    uint first = this->size();
+    uint n = first + count;
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        this->position[d].resize(n);
+        this->velocity[d].resize(n);
+        this->acceleration[d].resize(n);
+        this->force[d].resize(n);
+        for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+            this->slot_force[s][d].resize(n);
+    }
+    this->mass.resize(n, mass);
+    this->inv_mass.resize(n, 1.0 / mass);
+
+    return first;
+}
+
+void NodeStore::reserve(uint count) {
+    uint n = this->size() + count;
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        this->position[d].reserve(n);
+        this->velocity[d].reserve(n);
+        this->acceleration[d].reserve(n);
+        this->force[d].reserve(n);
+        for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+            this->slot_force[s][d].reserve(n);
     }
+    this->mass.reserve(n);
+    this->inv_mass.reserve(n);
 }
 
-void Node::set_force(string identifier, vector<double> f_vector) {
-    this->forces[identifier] = f_vector;
+uint NodeStore::size() {
+    return this->mass.size();
 }
 
-void Node::remove_force(string identifier) {
-    this->forces.erase(identifier);
+void NodeStore::clear_forces() {
+    clear_forces(0, this->size());
 }
 
-vector<double> Node::force_sum() {
-    vector<double> sum;
-    for (auto pair : this->forces) {
-        if (sum.size() == 0) {
-            sum = pair.second;
-        } else {
-            sum = vector_sum(sum, pair.second);
+void NodeStore::clear_forces(uint begin, uint end) {
+    for (uint d = 0; d < DIMENSIONS; d++)
+        fill(this->force[d].begin() + begin, this->force[d].begin() + end, 0.);
+}
+
+void NodeStore::update_state(double time_step, vec_t external_force) {
+    update_state(time_step, external_force, 0, this->size());
+}
+
+// Integrates nodes [begin, end). external_force is added to every node, on top of the accumulated and per-node slot forces.
+void NodeStore::update_state(double time_step, vec_t external_force, uint begin, uint end) {
+    const double *im = this->inv_mass.data();
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        double *p = this->position[d].data();
+        double *v = this->velocity[d].data();
+        double *a = this->acceleration[d].data();
+        double *f = this->force[d].data();
+        const double *f_pull = this->slot_force[FORCE_PULL][d].data();
+        const double *f_normal = this->slot_force[FORCE_NORMAL][d].data();
+        const double *f_friction = this->slot_force[FORCE_FRICTION][d].data();
+        const double *f_gravity = this->slot_force[FORCE_GRAVITY][d].data();
+        double f_ext = external_force[d];
+
+        for (uint i = begin; i < end; i++) {
+            f[i] += f_ext + f_gravity[i] + f_pull[i] + f_normal[i] + f_friction[i];
+
+            double new_a = f[i] * im[i];
+            double avg_a = (a[i] + new_a) * 0.5;
+
+            double new_v = v[i] + avg_a * time_step;
+            double avg_v = (v[i] + new_v) * 0.5;
+
+            p[i] = p[i] + avg_v * time_step;
+            v[i] = new_v;
+            a[i] = new_a;
         }
     }
+}
 
-    return sum;
+void NodeStore::write(utils::BinaryWriter *out) {
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        out->write_array(this->position[d]);
+        out->write_array(this->velocity[d]);
+        out->write_array(this->acceleration[d]);
+        out->write_array(this->force[d]);
+        for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+            out->write_array(this->slot_force[s][d]);
+    }
+    out->write_array(this->mass);
+    out->write_array(this->inv_mass);
+    out->write(this->slot_force_changes);
+}
+
+bool NodeStore::read(utils::BinaryReader *in) {
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        in->read_array(&this->position[d]);
+        in->read_array(&this->velocity[d]);
+        in->read_array(&this->acceleration[d]);
+        in->read_array(&this->force[d]);
+        for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+            in->read_array(&this->slot_force[s][d]);
+    }
+    in->read_array(&this->mass);
+    in->read_array(&this->inv_mass);
+    in->read(&this->slot_force_changes);
+    if (!in->good())
+        return false;
+
+    uint n = this->size();
+    bool sizes_match = this->inv_mass.size() == n;
+    for (uint d = 0; d < DIMENSIONS; d++) {
+        sizes_match = sizes_match && this->position[d].size() == n && this->velocity[d].size() == n
+            && this->acceleration[d].size() == n && this->force[d].size() == n;
+        for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+            sizes_match = sizes_match && this->slot_force[s][d].size() == n;
+    }
+    return sizes_match;
 }
 
-void Node::set_velocity(vector<double> velocity) {
-    this->velocity = velocity;
+Node::Node() = default;
+Node::Node(NodeStore *store, uint index)
+{
+    this->store = store;
+    this->index = index;
 }
 
-void Node::set_acceleration(vector<double> acceleration) {
-    this->acceleration = acceleration;
+void Node::add_force(vec_t f_vector) {
+    for (uint d = 0; d < DIMENSIONS; d++)
+        this->store->force[d][this->index] += f_vector[d];
 }
 
-void Node::set_position(vector<double> position) {
-    this->position = position;
+void Node::set_force(force_slot slot, vec_t f_vector) {
+    bool changed = false;
+    for (uint d = 0; d < DIMENSIONS; d++)
+    {
+        double &f = this->store->slot_force[slot][d][this->index];
+        changed = changed || f != f_vector[d];
+        f = f_vector[d];
+    }
+    if (changed)
+        this->store->slot_force_changes++;
 }
 
-void Node::update_state(double time_step) {
-    auto m = this->mass;
-    auto a = this->acceleration;
-    auto v = this->velocity;
-    auto p = this->position;
-    auto f_sum = force_sum();
+void Node::remove_force(force_slot slot) {
+    set_force(slot, vec_t{});
+}
 
-    vector<double> new_a = scale_vector(f_sum, 1.0/m);
-    vector<double> avg_a = scale_vector(vector_sum(a, new_a), 0.5);
+// sum of all forces acting on the node during the last step
+vec_t Node::force_sum() {
+    vec_t sum;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        sum[d] = this->store->force[d][this->index];
 
-    vector<double> new_v = vector_sum(v, scale_vector(avg_a, time_step));
-    vector<double> avg_v = scale_vector(vector_sum(v, new_v), 0.5);
+    return sum;
+}
 
-    vector<double> new_p = vector_sum(p, scale_vector(avg_v, time_step));
+void Node::set_velocity(vec_t velocity) {
+    for (uint d = 0; d < DIMENSIONS; d++)
+        this->store->velocity[d][this->index] = velocity[d];
+}
 
-    this->acceleration = new_a;
-    this->velocity = new_v;
-    this->position = new_p;
+void Node::set_acceleration(vec_t acceleration) {
+    for (uint d = 0; d < DIMENSIONS; d++)
+        this->store->acceleration[d][this->index] = acceleration[d];
+}
+
+void Node::set_position(vec_t position) {
+    for (uint d = 0; d < DIMENSIONS; d++)
+        this->store->position[d][this->index] = position[d];
 }
 
 double Node::get_mass() {
-    return this->mass;
+    return this->store->mass[this->index];
+}
+
+vec_t Node::get_acceleration() {
+    vec_t a;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        a[d] = this->store->acceleration[d][this->index];
+    return a;
+}
+
+vec_t Node::get_velocity() {
+    vec_t v;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        v[d] = this->store->velocity[d][this->index];
+    return v;
+}
+
+vec_t Node::get_position() {
+    vec_t p;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        p[d] = this->store->position[d][this->index];
+    return p;
+}
+
+vec_t Node::get_force(force_slot slot) {
+    vec_t f;
+    for (uint d = 0; d < DIMENSIONS; d++)
+        f[d] = this->store->slot_force[slot][d][this->index];
+    return f;
 }
 
-vector<double> Node::get_acceleration() {
-    return this->acceleration;
+NodeStore *Node::get_store() {
+    return this->store;
 }
 
-vector<double> Node::get_velocity() {
-    return this->velocity;
+uint Node::get_index() {
+    return this->index;
 }
 
-vector<double> Node::get_position() {
-    return this->position;
+bool Node::is_valid() {
+    return this->store != NULL;
 }
 
-vector<double> Node::get_force(string identifier) {
-    return this->forces.at(identifier);
+bool Node::operator==(const Node &other) const {
+    return this->store == other.store && this->index == other.index;
 }
 
-#endif
\ No newline at end of file
+#endif
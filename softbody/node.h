@@ -1,36 +1,88 @@
 #include <bits/stdc++.h>
+#include "../utils/vectors.cpp"
 
 #ifndef SOFTBODY_NODE_H_
 #define SOFTBODY_NODE_H_
 
 using namespace std;
+using utils::vectors::vec_t;
 
+// see utils/binary_file.cpp, only the files writing and reading checkpoints need it
+namespace utils {
+    class BinaryWriter;
+    class BinaryReader;
+}
+
+// Named forces that persist between steps until they're set again.
+enum force_slot {
+    FORCE_GRAVITY,
+    FORCE_PULL,
+    FORCE_NORMAL,
+    FORCE_FRICTION,
+    FORCE_SLOT_COUNT
+};
+
+// State of every node of a body, stored as one contiguous array per component.
+class NodeStore {
+    public:
+        vector<double> position[DIMENSIONS];
+        vector<double> velocity[DIMENSIONS];
+        vector<double> acceleration[DIMENSIONS];
+        // force accumulator: cleared at the start of a step, edges add their spring forces into it and
+        // update_state adds the slot forces. Holds the sum of all forces on the node after the step.
+        vector<double> force[DIMENSIONS];
+        vector<double> slot_force[FORCE_SLOT_COUNT][DIMENSIONS];
+        // counts the changes of slot forces made through Node, lets a sleeping body notice a pull
+        uint64_t slot_force_changes = 0;
+        vector<double> mass; // allows negative mass
+        vector<double> inv_mass;
+
+        uint add(vec_t position, double mass);
+        // appends count nodes at rest at the origin, returns the index of the first
+        uint add(uint count, double mass);
+        // makes room for count more nodes, so adding them doesn't reallocate
+        void reserve(uint count);
+        uint size();
+
+        void clear_forces();
+        void clear_forces(uint begin, uint end);
+        void update_state(double time_step, vec_t external_force);
+        void update_state(double time_step, vec_t external_force, uint begin, uint end);
+
+        // every array and the change counter, see Simulator::save_checkpoint. read fails on arrays of different
+        // lengths.
+        void write(utils::BinaryWriter *out);
+        bool read(utils::BinaryReader *in);
+};
+
+// Lightweight handle to one node inside a NodeStore.
 class Node {
     private:
-        double mass; // allows negative mass
-        vector<double> acceleration;
-        vector<double> velocity;
-        vector<double> position;
-        unordered_map<string, vector<double>> forces;
+        NodeStore *store = NULL;
+        uint index = 0;
 
     public:
         Node();
-        Node(vector<double> position, double mass);
+        Node(NodeStore *store, uint index);
 
-        void remove_force(string identifier);
-        void set_force(string identifier, vector<double> f_vector);
-        void set_acceleration(vector<double> acceleration);
-        void set_velocity(vector<double> velocity);
-        void set_position(vector<double> position);
-
-        void update_state(double time_step);
+        void add_force(vec_t f_vector);
+        void remove_force(force_slot slot);
+        void set_force(force_slot slot, vec_t f_vector);
+        void set_acceleration(vec_t acceleration);
+        void set_velocity(vec_t velocity);
+        void set_position(vec_t position);
 
         double get_mass();
-        vector<double> get_acceleration();
-        vector<double> get_velocity();
-        vector<double> get_position();
-        vector<double> get_force(string identifier);
-        vector<double> force_sum();
+        vec_t get_acceleration();
+        vec_t get_velocity();
+        vec_t get_position();
+        vec_t get_force(force_slot slot);
+        vec_t force_sum();
+
+        NodeStore *get_store();
+        uint get_index();
+        bool is_valid();
+        bool operator==(const Node &other) const;
 };
 
-#endif
\ No newline at end of file
+#endif
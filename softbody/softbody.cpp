@@ -2,11 +2,12 @@
 #include <math.h>
 
 #include "../utils/vectors.cpp"
-#include "../utils/id.cpp"
+#include "../utils/binary_file.cpp"
 
 #include "node.h"
 #include "edge.h"
 #include "softbody.h"
+#include "spring_kernel.cpp"
 
 #ifndef SOFTBODY_SOFTBODY_CC_
 #define SOFTBODY_SOFTBODY_CC_
@@ -15,165 +16,422 @@ using namespace std;
 using namespace utils;
 using namespace utils::vectors;
 
-/*
-SoftBody::SoftBody() = default;
-
-SoftBody::SoftBody(vector<Node> *nodes, list<Edge> *edges, double edge_deform_at, double edge_deform_coeff, double edge_tear_at)
-: this->nodes (nodes), this->edges (edges)
-{}
-*/
+SoftBody::SoftBody() {
+    this->edge_deform_at = INF;
+    this->edge_deform_coef = INF;
+    this->edge_tear_at = INF;
+}
 
-SoftBody::SoftBody(vector<Node> *nodes, list<Edge> *edges, double edge_deform_at, double edge_deform_coeff, double edge_tear_at) {
-    this->nodes = nodes;
-    this->edges = edges;
+SoftBody::SoftBody(double edge_deform_at, double edge_deform_coef, double edge_tear_at) {
     this->edge_deform_at = edge_deform_at;
     this->edge_deform_coef = edge_deform_coef;
     this->edge_tear_at = edge_tear_at;
-    set_edge_ids();
 }
 
-SoftBody::SoftBody() {
-    this->nodes = nodes;
-    this->edges = edges;
-    this->edge_deform_at = edge_deform_at;
-    this->edge_deform_coef = edge_deform_coef;
-    this->edge_tear_at = edge_tear_at;
-    set_edge_ids();
+Node SoftBody::add_node(vec_t position, double mass) {
+    uint index = this->nodes.add(position, mass);
+    return Node(&this->nodes, index);
 }
 
-SoftBody::SoftBody(vector<Node> nodes, list<Edge> edges) {
-    this->nodes = new vector<Node>(nodes);
-    this->edges = new list<Edge>(edges);
-    this->edge_deform_at = INF;
-    this->edge_deform_coef = INF;
-    this->edge_tear_at = INF;
-    set_edge_ids();
+Edge SoftBody::add_edge(uint node1, uint node2, double spring_coef, double damping_coef, double rest_length) {
+    uint index = this->edges.add(node1, node2, spring_coef, damping_coef, rest_length);
+    return Edge(&this->edges, &this->nodes, index);
 }
 
-SoftBody::SoftBody(vector<Node> *nodes, list<Edge> *edges) {
-    this->nodes = nodes;
-    this->edges = edges;
-    this->edge_deform_at = INF;
-    this->edge_deform_coef = INF;
-    this->edge_tear_at = INF;
-    set_edge_ids();
+Edge SoftBody::add_edge(uint node1, uint node2, double spring_coef, double damping_coef) {
+    vec_t p1 = get_node(node1).get_position();
+    vec_t p2 = get_node(node2).get_position();
+    return add_edge(node1, node2, spring_coef, damping_coef, vector_len(p2 - p1));
 }
 
-SoftBody::~SoftBody() {
-    delete[] this->nodes;
-    delete[] this->edges;
+Edge SoftBody::add_edge(Node node1, Node node2, double spring_coef, double damping_coef) {
+    return add_edge(node1.get_index(), node2.get_index(), spring_coef, damping_coef);
 }
 
-void SoftBody::set_external_force(string identifier, vector<double> force_vect) {
-    this->external_forces.emplace(identifier, force_vect);
+uint SoftBody::add_nodes(uint count, double mass) {
+    return this->nodes.add(count, mass);
+}
+
+uint SoftBody::add_edges(uint count) {
+    return this->edges.add(count);
+}
+
+void SoftBody::reserve(uint node_count, uint edge_count) {
+    this->nodes.reserve(node_count);
+    this->edges.reserve(edge_count);
+}
+
+void SoftBody::set_external_force(force_slot slot, vec_t force_vect) {
+    this->external_forces[slot] = force_vect;
 }
 
 void SoftBody::advance_physics(double time_step) {
-    list<Edge>::iterator edge_ptr;
-    list<Edge>::iterator edge_to_tear = this->edges->end();
-    for (edge_ptr = this->edges->begin(); edge_ptr != this->edges->end(); edge_ptr++)
+    PROFILE_SCOPE("SoftBody::advance_physics");
+    if (this->method == INTEGRATE_IMPLICIT)
+        advance_physics_implicit(time_step);
+    else if (this->method == INTEGRATE_XPBD)
+        advance_physics_xpbd(time_step);
+    else
+        advance_physics_explicit(time_step);
+}
+
+// Springs are evaluated one color at a time with the batched kernel. The edges of a color share no nodes, so a
+// color can be split between threads without synchronizing on the node accumulators, and the results don't
+// depend on the thread count. Nodes are integrated in disjoint ranges.
+void SoftBody::advance_physics_explicit(double time_step) {
+    NodeStore *nodes = &this->nodes;
+    EdgeTable *edges = &this->edges;
+
+    for_range(nodes->size(), true, [&](uint begin, uint end) { nodes->clear_forces(begin, end); });
+
+    atomic<bool> tear(false);
+    for_each_color([&](uint begin, uint end, bool conflict_free) {
+        bool torn;
+        if (conflict_free)
+            torn = spring_kernel::apply(edges, nodes, begin, end, this->edge_deform_at, this->edge_tear_at);
+        else
+            torn = edges->apply_forces(nodes, begin, end, this->edge_deform_at, this->edge_tear_at);
+        if (torn)
+            tear.store(true, memory_order_relaxed);
+    });
+    if (tear)
+        edges->remove_torn(this->edge_tear_at);
+
+    vec_t external_force = get_external_force_sum();
+    for_range(nodes->size(), true, [&](uint begin, uint end) { nodes->update_state(time_step, external_force, begin, end); });
+}
+
+// Backward Euler step, see ImplicitSolver. The node and edge passes are split like the explicit step, the dot
+// products of CG are split with sum_range.
+void SoftBody::advance_physics_implicit(double time_step) {
+    NodeStore *nodes = &this->nodes;
+    EdgeTable *edges = &this->edges;
+    ImplicitSolver *solver = &this->solver;
+    uint n = nodes->size();
+    double h = time_step;
+
+    solver->resize(n, edges->size());
+    for_range(n, true, [&](uint begin, uint end) { solver->begin_nodes(nodes, begin, end); });
+
+    atomic<bool> tear(false);
+    for_each_color([&](uint begin, uint end, bool) {
+        if (solver->assemble(nodes, edges, begin, end, h, this->edge_deform_at, this->edge_tear_at))
+            tear.store(true, memory_order_relaxed);
+    });
+
+    vec_t external_force = get_external_force_sum();
+    for_range(n, true, [&](uint begin, uint end) { solver->begin_solve(nodes, begin, end, h, external_force); });
+
+    // q = A x for the initial guess, then r = b - A x
+    for_each_color([&](uint begin, uint end, bool) { solver->multiply_edges(edges, solver->x, solver->q, begin, end); });
+    for_range(n, true, [&](uint begin, uint end) { solver->initial_residual(nodes, begin, end); });
+
+    auto residual_dots = [&](uint begin, uint end) {
+        pair<double, double> dots;
+        solver->residual_dots(begin, end, &dots.first, &dots.second);
+        return dots;
+    };
+    pair<double, double> dots = sum_range(n, residual_dots);
+    double rz = dots.first, r_norm_sq = dots.second;
+    double initial_norm_sq = r_norm_sq;
+    double threshold_sq = solver->tolerance * solver->tolerance * initial_norm_sq;
+    uint iteration = 0;
+    for (; iteration < solver->max_iterations && r_norm_sq > threshold_sq; iteration++)
+    {
+        // q holds M p, add the edge part
+        for_each_color([&](uint begin, uint end, bool) { solver->multiply_edges(edges, solver->p, solver->q, begin, end); });
+
+        double pq = sum_range(n, [&](uint begin, uint end) {
+            return make_pair(solver->dot(solver->p, solver->q, begin, end), 0.);
+        }).first;
+        if (pq <= 0)
+            break;
+        double alpha = rz / pq;
+        dots = sum_range(n, [&](uint begin, uint end) {
+            pair<double, double> range_dots;
+            solver->update_solution(alpha, begin, end, &range_dots.first, &range_dots.second);
+            return range_dots;
+        });
+        double rz_next = dots.first;
+        r_norm_sq = dots.second;
+        double beta = rz_next / rz;
+        rz = rz_next;
+        for_range(n, true, [&](uint begin, uint end) { solver->update_direction(nodes, beta, begin, end); });
+    }
+    solver->last_iterations = iteration;
+    solver->last_residual = initial_norm_sq > 0 ? sqrt(r_norm_sq / initial_norm_sq) : 0;
+
+    for_range(n, true, [&](uint begin, uint end) { solver->finish_nodes(nodes, begin, end, h); });
+    if (tear)
+        edges->remove_torn(this->edge_tear_at);
+}
+
+// XPBD step, see XpbdSolver. Edges are projected color by color like the explicit force pass, contacts and
+// velocities are updated in disjoint node ranges.
+void SoftBody::advance_physics_xpbd(double time_step) {
+    NodeStore *nodes = &this->nodes;
+    EdgeTable *edges = &this->edges;
+    XpbdSolver *xpbd = &this->xpbd;
+    uint n = nodes->size();
+    uint substeps = max(xpbd->substeps, 1u);
+    double h = time_step / substeps;
+
+    xpbd->resize(n, edges->size());
+    for_range(n, true, [&](uint begin, uint end) { xpbd->begin_nodes(nodes, begin, end); });
+
+    atomic<bool> tear(false);
+    for_each_color([&](uint begin, uint end, bool) {
+        if (xpbd->begin_edges(edges, begin, end, this->edge_deform_at, this->edge_tear_at))
+            tear.store(true, memory_order_relaxed);
+    });
+
+    vec_t external_force = get_external_force_sum();
+    for (uint s = 0; s < substeps; s++)
     {
-        Node *node1 = edge_ptr->get_node1();
-        Node *node2 = edge_ptr->get_node2();
+        for_range(n, true, [&](uint begin, uint end) { xpbd->predict(nodes, begin, end, h, external_force); });
+        fill(xpbd->lambda.begin(), xpbd->lambda.end(), 0.);
 
-        // tear edge
-        if (edge_ptr->get_deformation() > this->edge_tear_at)
+        for (uint it = 0; it < xpbd->iterations; it++)
         {
-            node1->remove_force(edge_ptr->get_edge_id());
-            node2->remove_force(edge_ptr->get_edge_id());
-            edge_to_tear = edge_ptr;
-            continue;
+            for_each_color([&](uint begin, uint end, bool) { xpbd->project_edges(nodes, edges, begin, end, h, this->edge_tear_at); });
+            for_range(n, true, [&](uint begin, uint end) { xpbd->project_contacts(nodes, begin, end); });
         }
 
-        // deform edge
-        if (edge_ptr->get_deformation() > this->edge_deform_at)
-            edge_ptr->set_rest_length(edge_ptr->get_rest_length() + edge_ptr->get_deformation());
-
-        // update spring f
-        auto f = edge_ptr->calculate_spring_force();
-        node1->set_force(edge_ptr->get_edge_id(), f.first);
-        node2->set_force(edge_ptr->get_edge_id(), f.second);
-
-        // damping
-        auto damp_v = edge_ptr->calculate_damping_vectors();
-        vector<double> vel1 = vector_sum(node1->get_velocity(), damp_v.first);
-        vector<double> vel2 = vector_sum(node2->get_velocity(), damp_v.second);
-        node1->set_velocity(vel1);
-        node2->set_velocity(vel2);
+        for_range(n, true, [&](uint begin, uint end) { xpbd->update_velocities(nodes, begin, end, h); });
     }
 
-    if (edge_to_tear != this->edges->end())
-        this->edges->erase(edge_to_tear);
+    for_each_color([&](uint begin, uint end, bool) { xpbd->finish_edges(nodes, edges, begin, end, this->edge_tear_at); });
+    for_range(n, true, [&](uint begin, uint end) { xpbd->finish_nodes(nodes, begin, end, time_step); });
+    if (tear)
+        edges->remove_torn(this->edge_tear_at);
+}
+
+void SoftBody::set_integration_method(integration_method method) {
+    this->method = method;
+}
+
+integration_method SoftBody::get_integration_method() {
+    return this->method;
+}
 
-    vector<Node>::iterator n_ptr;
-    for (n_ptr = this->nodes->begin(); n_ptr != this->nodes->end(); n_ptr++)
+ImplicitSolver *SoftBody::get_implicit_solver() {
+    return &this->solver;
+}
+
+XpbdSolver *SoftBody::get_xpbd_solver() {
+    return &this->xpbd;
+}
+
+void SoftBody::set_contact_box(vec_t lower, vec_t upper, double bounce_coef, double friction_coef) {
+    this->xpbd.lower = lower;
+    this->xpbd.upper = upper;
+    this->xpbd.bounce_coef = bounce_coef;
+    this->xpbd.friction_coef = friction_coef;
+}
+
+void SoftBody::set_thread_pool(utils::ThreadPool *pool) {
+    this->pool = pool;
+}
+
+void SoftBody::set_deterministic(bool deterministic) {
+    this->deterministic = deterministic;
+}
+
+void SoftBody::save_state(body_state *out) {
+    out->nodes = this->nodes;
+    out->edges = this->edges;
+}
+
+void SoftBody::restore_state(const body_state &state) {
+    this->nodes = state.nodes;
+    this->edges = state.edges;
+}
+
+void SoftBody::write(utils::BinaryWriter *out) {
+    out->write(this->edge_deform_at);
+    out->write(this->edge_deform_coef);
+    out->write(this->edge_tear_at);
+    for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+        out->write(this->external_forces[s]);
+    out->write(this->method);
+    out->write(this->solver.tolerance);
+    out->write(this->solver.max_iterations);
+    out->write(this->solver.last_iterations);
+    out->write(this->solver.last_residual);
+    out->write(this->xpbd.substeps);
+    out->write(this->xpbd.iterations);
+    out->write(this->xpbd.lower);
+    out->write(this->xpbd.upper);
+    out->write(this->xpbd.bounce_coef);
+    out->write(this->xpbd.friction_coef);
+    out->write(this->sleeping);
+    out->write(this->sleep_force_changes);
+    out->write(this->sleep_external_force);
+    this->nodes.write(out);
+    this->edges.write(out);
+}
+
+bool SoftBody::read(utils::BinaryReader *in) {
+    in->read(&this->edge_deform_at);
+    in->read(&this->edge_deform_coef);
+    in->read(&this->edge_tear_at);
+    for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+        in->read(&this->external_forces[s]);
+    in->read(&this->method);
+    in->read(&this->solver.tolerance);
+    in->read(&this->solver.max_iterations);
+    in->read(&this->solver.last_iterations);
+    in->read(&this->solver.last_residual);
+    in->read(&this->xpbd.substeps);
+    in->read(&this->xpbd.iterations);
+    in->read(&this->xpbd.lower);
+    in->read(&this->xpbd.upper);
+    in->read(&this->xpbd.bounce_coef);
+    in->read(&this->xpbd.friction_coef);
+    in->read(&this->sleeping);
+    in->read(&this->sleep_force_changes);
+    in->read(&this->sleep_external_force);
+    if (!in->good() || this->method > INTEGRATE_XPBD)
+        return false;
+    return this->nodes.read(in) && this->edges.read(in, this->nodes.size());
+}
+
+// The highest frequency of the springs is bounded by the largest row sum of M^-1 K (Gershgorin), which is twice
+// the summed spring coefficients of a node over its mass. The explicit step averages in the previous step's
+// acceleration, which halves the leapfrog limit to dt < 1 / omega.
+double SoftBody::get_stable_time_step() {
+    if (this->method != INTEGRATE_EXPLICIT)
+        return numeric_limits<double>::infinity();
+
+    EdgeTable *edges = get_adjacency();
+    double max_omega_sq = 0;
+    for (uint n = 0; n < this->nodes.size(); n++)
     {
-        for (auto f : this->external_forces)
-        {
-            n_ptr->set_force(f.first, f.second);
-        }
-        n_ptr->update_state(time_step);
+        double stiffness = 0;
+        for (uint a = edges->adjacency_start[n]; a < edges->adjacency_start[n + 1]; a++)
+            stiffness += fabs(edges->spring_coef[edges->adjacency[a]]);
+        max_omega_sq = max(max_omega_sq, 2 * stiffness * fabs(this->nodes.inv_mass[n]));
+    }
+    if (max_omega_sq == 0)
+        return numeric_limits<double>::infinity();
+    return 1 / sqrt(max_omega_sq);
+}
+
+void SoftBody::sleep() {
+    for (uint d = 0; d < DIMENSIONS; d++)
+    {
+        fill(this->nodes.velocity[d].begin(), this->nodes.velocity[d].end(), 0.);
+        fill(this->nodes.acceleration[d].begin(), this->nodes.acceleration[d].end(), 0.);
     }
+    this->sleeping = true;
+    this->sleep_force_changes = this->nodes.slot_force_changes;
+    this->sleep_external_force = get_external_force_sum();
 }
 
-void SoftBody::add_velocity(vector<double> v_vect)
+void SoftBody::wake() {
+    this->sleeping = false;
+}
+
+bool SoftBody::is_sleeping() {
+    return this->sleeping;
+}
+
+bool SoftBody::forces_changed_while_sleeping() {
+    return this->nodes.slot_force_changes != this->sleep_force_changes || !(get_external_force_sum() == this->sleep_external_force);
+}
+
+double SoftBody::get_kinetic_energy() {
+    double energy = 0;
+    for (uint d = 0; d < DIMENSIONS; d++)
+    {
+        const double *v = this->nodes.velocity[d].data();
+        for (uint i = 0; i < this->nodes.size(); i++)
+            energy += this->nodes.mass[i] * v[i] * v[i];
+    }
+    return energy / 2;
+}
+
+double SoftBody::get_mass() {
+    return accumulate(this->nodes.mass.begin(), this->nodes.mass.end(), 0.);
+}
+
+void SoftBody::add_velocity(vec_t v_vect)
 {
-    vector<Node>::iterator n_ptr;
-    for (n_ptr = this->nodes->begin(); n_ptr != this->nodes->end(); n_ptr++)
+    uint n = this->nodes.size();
+    for (uint d = 0; d < DIMENSIONS; d++)
     {
-        vector<double> new_v = vector_sum(n_ptr->get_velocity(), v_vect);
-        n_ptr->set_velocity(new_v);
+        double *v = this->nodes.velocity[d].data();
+        for (uint i = 0; i < n; i++)
+            v[i] += v_vect[d];
     }
 }
 
 
-void SoftBody::move_relative(vector<double> transform_vect)
+void SoftBody::move_relative(vec_t transform_vect)
 {
-    vector<Node>::iterator n_ptr;
-    for (n_ptr = this->nodes->begin(); n_ptr != this->nodes->end(); n_ptr++)
+    uint n = this->nodes.size();
+    for (uint d = 0; d < DIMENSIONS; d++)
     {
-        n_ptr->set_position(vector_sum(n_ptr->get_position(), transform_vect));
+        double *p = this->nodes.position[d].data();
+        for (uint i = 0; i < n; i++)
+            p[i] += transform_vect[d];
     }
 }
 
-void SoftBody::move_absolute(vector<double> top_left_pos)
+void SoftBody::move_absolute(vec_t top_left_pos)
 {
-    vector<double> obj_top_left = this->nodes->front().get_position();
+    vec_t obj_top_left = get_node(0).get_position();
 
-    vector<Node>::iterator n_ptr;
-    for (n_ptr = this->nodes->begin(); n_ptr != this->nodes->end(); n_ptr++)
+    uint n = this->nodes.size();
+    for (uint d = 0; d < DIMENSIONS; d++)
     {
-        vector<double> pos = n_ptr->get_position();
-        obj_top_left[0] = min(pos[0], obj_top_left[0]);
-        obj_top_left[1] = min(pos[1], obj_top_left[1]);
+        const double *p = this->nodes.position[d].data();
+        for (uint i = 0; i < n; i++)
+            obj_top_left[d] = min(p[i], obj_top_left[d]);
     }
-    vector<double> transform_vect = vector_sub(obj_top_left, top_left_pos);
+    vec_t transform_vect = obj_top_left - top_left_pos;
     move_relative(transform_vect);
 }
 
 void SoftBody::set_edge_ids()
 {
-    list<Edge>::iterator e_ptr;
-    for (e_ptr = this->edges->begin(); e_ptr != this->edges->end(); e_ptr++)
-    {
-        e_ptr->set_id(utils::a_gen_id());
-    }
+    for (uint i = 0; i < this->edges.size(); i++)
+        this->edges.id[i] = i;
+    this->edges.next_id = this->edges.size();
+}
+
+vec_t SoftBody::get_force(force_slot slot) {
+    return this->external_forces[slot];
+}
+
+vec_t SoftBody::get_external_force_sum() {
+    vec_t sum{};
+    for (uint s = 0; s < FORCE_SLOT_COUNT; s++)
+        sum += this->external_forces[s];
+    return sum;
+}
+
+NodeStore *SoftBody::get_nodes() {
+    return &this->nodes;
 }
 
-vector<double> SoftBody::get_force(string identifier) {
-    return this->external_forces.at(identifier);
+EdgeTable *SoftBody::get_edges() {
+    return &this->edges;
 }
 
-map<string, vector<double>> SoftBody::get_all_forces() {
-    return this->external_forces;
+// edge table with the node to edge adjacency up to date
+EdgeTable *SoftBody::get_adjacency() {
+    if (!this->edges.adjacency_valid)
+        this->edges.build_adjacency(this->nodes.size());
+    return &this->edges;
 }
 
-vector<Node> *SoftBody::get_nodes() {
-    return this->nodes;
+Node SoftBody::get_node(uint index) {
+    return Node(&this->nodes, index);
 }
 
-list<Edge> *SoftBody::get_edges() {
-    return this->edges;
+Edge SoftBody::get_edge(uint index) {
+    return Edge(&this->edges, &this->nodes, index);
 }
 
 double SoftBody::get_edge_deform_at() {
@@ -1,46 +1,199 @@
 #include <bits/stdc++.h>
 #include "node.h"
 #include "edge.h"
+#include "../utils/thread_pool.cpp"
+#include "../utils/profiler.cpp"
+#include "implicit_solver.cpp"
+#include "xpbd_solver.cpp"
 
 #ifndef SOFTBODY_SOFTBODY_H_
 #define SOFTBODY_SOFTBODY_H_
 
 #define INF numeric_limits<double>::infinity();
+// ranges smaller than this are not worth splitting between threads
+#define PARALLEL_MIN_ITEMS 2048
+// items summed into one partial sum of a deterministic reduction, see SoftBody::sum_range
+#define REDUCTION_BLOCK 1024
 using namespace std;
 
+enum integration_method {
+    // averaged acceleration step, damping applied directly to the velocities
+    INTEGRATE_EXPLICIT,
+    // backward Euler step, stable for much larger time steps on stiff springs
+    INTEGRATE_IMPLICIT,
+    // position based constraints, fixed cost per step for any stiffness. Walls are handled by the body, see
+    // set_contact_box
+    INTEGRATE_XPBD
+};
+
+// Copy of the simulated state of a body, the node store and edge table, see SoftBody::save_state.
+// Saving into the same snapshot again reuses its memory.
+struct body_state {
+    NodeStore nodes;
+    EdgeTable edges;
+};
+
 class SoftBody
 {
 private:
-    vector<Node> *nodes;
-    list<Edge> *edges;
+    NodeStore nodes;
+    EdgeTable edges;
     double edge_deform_at;
     double edge_deform_coef;
     double edge_tear_at;
-    map<string, vector<double>> external_forces;
+    // forces applied to every node of the body
+    vec_t external_forces[FORCE_SLOT_COUNT] = {};
+    utils::ThreadPool *pool = NULL;
+    bool deterministic = true;
+    // partial sums of sum_range, one per block or thread
+    vector<pair<double, double>> partials;
+    integration_method method = INTEGRATE_EXPLICIT;
+    ImplicitSolver solver;
+    XpbdSolver xpbd;
+    bool sleeping = false;
+    // forces when the body fell asleep
+    uint64_t sleep_force_changes = 0;
+    vec_t sleep_external_force = {};
+
+    void advance_physics_explicit(double time_step);
+    void advance_physics_implicit(double time_step);
+    void advance_physics_xpbd(double time_step);
+
+    // calls fn(begin, end) for ranges covering [0, n), split between the pool's threads when it's worth it
+    template <typename _F>
+    void for_range(uint n, bool splittable, const _F &fn)
+    {
+        if (splittable && n >= PARALLEL_MIN_ITEMS && this->pool != NULL && this->pool->get_thread_count() > 1)
+            this->pool->parallel_for(n, fn);
+        else
+            fn(0, n);
+    }
+
+    // Sums the pairs fn(begin, end) returns for ranges covering [0, n). A deterministic body sums blocks of
+    // REDUCTION_BLOCK items and adds the blocks up in order, so the sums are the same for any thread count and
+    // schedule. Otherwise every thread sums one contiguous range and the ranges are added up in order, the sums
+    // then depend on the thread count.
+    template <typename _F>
+    pair<double, double> sum_range(uint n, const _F &fn)
+    {
+        bool split = n >= PARALLEL_MIN_ITEMS && this->pool != NULL && this->pool->get_thread_count() > 1;
+        uint ranges, range_size;
+        if (this->deterministic)
+        {
+            range_size = REDUCTION_BLOCK;
+            ranges = (n + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+        }
+        else
+        {
+            ranges = split ? this->pool->get_thread_count() : 1;
+            range_size = (n + ranges - 1) / ranges;
+        }
+
+        this->partials.resize(ranges);
+        auto sum_ranges = [&](uint begin, uint end) {
+            for (uint r = begin; r < end; r++)
+                this->partials[r] = fn(min(r * range_size, n), min((r + 1) * range_size, n));
+        };
+        if (split)
+            this->pool->parallel_for(ranges, sum_ranges, this->deterministic ? 0 : ranges);
+        else
+            sum_ranges(0, ranges);
+
+        pair<double, double> sum = {0, 0};
+        for (uint r = 0; r < ranges; r++)
+        {
+            sum.first += this->partials[r].first;
+            sum.second += this->partials[r].second;
+        }
+        return sum;
+    }
+
+    // calls fn(begin, end, conflict_free) for the edges of each color in order, a conflict free color is split
+    // between threads
+    template <typename _F>
+    void for_each_color(const _F &fn)
+    {
+        EdgeTable *edges = &this->edges;
+        if (!edges->coloring_valid)
+            edges->build_coloring(this->nodes.size());
+        for (uint c = 0; c + 1 < edges->color_start.size(); c++)
+        {
+            uint start = edges->color_start[c];
+            bool conflict_free = c < edges->conflict_free_colors;
+            for_range(edges->color_start[c + 1] - start, conflict_free, [&](uint begin, uint end) {
+                fn(start + begin, start + end, conflict_free);
+            });
+        }
+    }
 
 public:
     SoftBody();
-    SoftBody(vector<Node> *nodes, list<Edge> *edges, double edge_deform_at, double edge_deform_coeff, double edge_tear_at);
-    SoftBody(vector<Node> nodes, list<Edge> edges);
-    SoftBody(vector<Node> *nodes, list<Edge> *edges);
-    ~SoftBody();
+    SoftBody(double edge_deform_at, double edge_deform_coef, double edge_tear_at);
 
-    void set_external_force(string identifier, vector<double> force_vect);
+    Node add_node(vec_t position, double mass);
+    // if rest_length not given, set rest_length as the current distance of nodes 1 and 2.
+    Edge add_edge(uint node1, uint node2, double spring_coef, double damping_coef);
+    Edge add_edge(uint node1, uint node2, double spring_coef, double damping_coef, double rest_length);
+    Edge add_edge(Node node1, Node node2, double spring_coef, double damping_coef);
+    // Append count nodes at the origin or count edges with their ids set and every other field zero, the caller
+    // fills in the arrays. Return the index of the first, see meshes.h for builders using them.
+    uint add_nodes(uint count, double mass);
+    uint add_edges(uint count);
+    // makes room for node_count more nodes and edge_count more edges before adding them one by one
+    void reserve(uint node_count, uint edge_count);
+
+    void set_external_force(force_slot slot, vec_t force_vect);
 
     void advance_physics(double time_step);
+    void set_integration_method(integration_method method);
+    integration_method get_integration_method();
+    // tolerance, iteration limit and statistics of the implicit step
+    ImplicitSolver *get_implicit_solver();
+    // substeps and iterations of the XPBD step
+    XpbdSolver *get_xpbd_solver();
+    // walls of the XPBD step, nodes are kept inside [lower, upper]
+    void set_contact_box(vec_t lower, vec_t upper, double bounce_coef, double friction_coef);
+    // steps the body on the pool's threads, NULL to step it on the calling thread only
+    void set_thread_pool(utils::ThreadPool *pool);
+    // Deterministic bodies step bit for bit the same on any thread count, see sum_range. On by default, turning it
+    // off lets the sums of the implicit step depend on the thread count and schedule.
+    void set_deterministic(bool deterministic);
+
+    void save_state(body_state *out);
+    void restore_state(const body_state &state);
+    // Nodes, edges, forces, tearing limits, integrator settings and sleep state, see Simulator::save_checkpoint.
+    // read is meant for a new body and fails on a malformed body, the thread pool is not part of it.
+    void write(utils::BinaryWriter *out);
+    bool read(utils::BinaryReader *in);
+    // largest stable time step of the explicit step from the stiffest node, infinite for the other methods
+    double get_stable_time_step();
+
+    // A sleeping body keeps its positions and is not stepped by the simulator, see Simulator::set_sleeping.
+    // Falling asleep stops every node.
+    void sleep();
+    void wake();
+    bool is_sleeping();
+    // true if a node's slot force or an external force changed since the body fell asleep
+    bool forces_changed_while_sleeping();
+    double get_kinetic_energy();
+    double get_mass();
 
-    void add_velocity(vector<double> v_vect);
-    void move_relative(vector<double> transform_vect);
-    void move_absolute(vector<double> top_left_pos);
+    void add_velocity(vec_t v_vect);
+    void move_relative(vec_t transform_vect);
+    void move_absolute(vec_t top_left_pos);
 
+    // renumbers the edges 0, 1, ... in their current order
     void set_edge_ids();
 
-    vector<double> get_force(string identifier);
-    map<string, vector<double>> get_all_forces();
-    vector<Node> *get_nodes();
-    list<Edge> *get_edges();
+    vec_t get_force(force_slot slot);
+    vec_t get_external_force_sum();
+    NodeStore *get_nodes();
+    EdgeTable *get_edges();
+    EdgeTable *get_adjacency();
+    Node get_node(uint index);
+    Edge get_edge(uint index);
     double get_edge_deform_at();
     double get_edge_tear_at();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,242 @@
+#include <bits/stdc++.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPRING_KERNEL_X86
+#endif
+
+#include "node.h"
+#include "edge.h"
+
+#ifndef SOFTBODY_SPRING_KERNEL_CC_
+#define SOFTBODY_SPRING_KERNEL_CC_
+
+using namespace std;
+
+// Batched version of EdgeTable::apply_forces for ranges of edges that share no nodes (one color of the edge
+// coloring). Length, deformation, spring force and the damping projection of several edges are computed in one
+// pass with SIMD, the results are then added to the nodes one edge at a time.
+//
+// The batches use the same operations in the same order as the scalar path and no fused multiply-adds, so results
+// match EdgeTable::apply_forces to the last bit on IEEE hardware. Callers may only rely on a relative difference
+// of at most SPRING_KERNEL_TOLERANCE per step, which leaves room for kernels that contract operations.
+#define SPRING_KERNEL_TOLERANCE 1e-12
+
+namespace spring_kernel {
+    enum implementation {
+        KERNEL_SCALAR,
+        KERNEL_SSE2,
+        KERNEL_AVX2,
+        KERNEL_AUTO
+    };
+
+    inline bool apply_scalar(EdgeTable *edges, NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at)
+    {
+        return edges->apply_forces(nodes, begin, end, deform_at, tear_at);
+    }
+
+#if defined(SPRING_KERNEL_X86) && DIMENSIONS == 2
+    // adds the results of one batch to the nodes, edges of a batch share no nodes
+    inline void scatter(NodeStore *nodes, const uint *n1, const uint *n2, uint count,
+                        const double *f_x, const double *f_y, const double *dv_x, const double *dv_y)
+    {
+        double *fx = nodes->force[0].data(), *fy = nodes->force[1].data();
+        double *vx = nodes->velocity[0].data(), *vy = nodes->velocity[1].data();
+        for (uint j = 0; j < count; j++)
+        {
+            fx[n1[j]] += f_x[j];
+            fy[n1[j]] += f_y[j];
+            fx[n2[j]] -= f_x[j];
+            fy[n2[j]] -= f_y[j];
+            vx[n1[j]] += dv_x[j];
+            vy[n1[j]] += dv_y[j];
+            vx[n2[j]] -= dv_x[j];
+            vy[n2[j]] -= dv_y[j];
+        }
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256d gather4(const double *base, __m128i index)
+    {
+        // masked form with an explicit source, the plain gather trips -Wmaybe-uninitialized
+        __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, all, 8);
+    }
+
+    __attribute__((target("avx2")))
+    inline bool apply_avx2(EdgeTable *edges, NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at)
+    {
+        const double *x = nodes->position[0].data(), *y = nodes->position[1].data();
+        const double *vx = nodes->velocity[0].data(), *vy = nodes->velocity[1].data();
+        const uint *n1 = edges->node1.data(), *n2 = edges->node2.data();
+        const double *k = edges->spring_coef.data(), *c = edges->damping_coef.data();
+        double *rest = edges->rest_length.data(), *deformation = edges->deformation.data();
+
+        const __m256d v_tear_at = _mm256_set1_pd(tear_at);
+        const __m256d v_deform_at = _mm256_set1_pd(deform_at);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d half = _mm256_set1_pd(0.5);
+        alignas(32) double f_x[4], f_y[4], dv_x[4], dv_y[4];
+        bool tear = false;
+
+        uint i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128i i1 = _mm_loadu_si128((const __m128i *)(n1 + i));
+            __m128i i2 = _mm_loadu_si128((const __m128i *)(n2 + i));
+
+            // tear and deform with the deformation of the previous step
+            __m256d d_old = _mm256_loadu_pd(deformation + i);
+            __m256d torn = _mm256_cmp_pd(d_old, v_tear_at, _CMP_GT_OQ);
+            if (_mm256_movemask_pd(torn))
+                tear = true;
+            __m256d deform = _mm256_andnot_pd(torn, _mm256_cmp_pd(d_old, v_deform_at, _CMP_GT_OQ));
+            __m256d r = _mm256_add_pd(_mm256_loadu_pd(rest + i), _mm256_and_pd(deform, d_old));
+            _mm256_storeu_pd(rest + i, r);
+
+            // spring force
+            __m256d dx = _mm256_sub_pd(gather4(x, i2), gather4(x, i1));
+            __m256d dy = _mm256_sub_pd(gather4(y, i2), gather4(y, i1));
+            __m256d len_sq = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+            __m256d dist = _mm256_sqrt_pd(len_sq);
+            __m256d d_new = _mm256_sub_pd(dist, r);
+            _mm256_storeu_pd(deformation + i, _mm256_blendv_pd(d_new, d_old, torn));
+
+            __m256d active = _mm256_andnot_pd(torn, _mm256_cmp_pd(dist, zero, _CMP_NEQ_OQ));
+            __m256d scale = _mm256_and_pd(active, _mm256_div_pd(_mm256_mul_pd(d_new, _mm256_loadu_pd(k + i)), dist));
+            _mm256_store_pd(f_x, _mm256_mul_pd(dx, scale));
+            _mm256_store_pd(f_y, _mm256_mul_pd(dy, scale));
+
+            // damping, relative velocity projected onto the edge
+            __m256d rvx = _mm256_sub_pd(gather4(vx, i2), gather4(vx, i1));
+            __m256d rvy = _mm256_sub_pd(gather4(vy, i2), gather4(vy, i1));
+            __m256d dot = _mm256_add_pd(_mm256_mul_pd(rvx, dx), _mm256_mul_pd(rvy, dy));
+            __m256d proj = _mm256_and_pd(active, _mm256_div_pd(dot, len_sq));
+            __m256d damp = _mm256_mul_pd(_mm256_loadu_pd(c + i), half);
+            _mm256_store_pd(dv_x, _mm256_mul_pd(_mm256_mul_pd(dx, proj), damp));
+            _mm256_store_pd(dv_y, _mm256_mul_pd(_mm256_mul_pd(dy, proj), damp));
+
+            scatter(nodes, n1 + i, n2 + i, 4, f_x, f_y, dv_x, dv_y);
+        }
+
+        if (i < end && apply_scalar(edges, nodes, i, end, deform_at, tear_at))
+            tear = true;
+        return tear;
+    }
+
+    inline bool apply_sse2(EdgeTable *edges, NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at)
+    {
+        const double *x = nodes->position[0].data(), *y = nodes->position[1].data();
+        const double *vx = nodes->velocity[0].data(), *vy = nodes->velocity[1].data();
+        const uint *n1 = edges->node1.data(), *n2 = edges->node2.data();
+        const double *k = edges->spring_coef.data(), *c = edges->damping_coef.data();
+        double *rest = edges->rest_length.data(), *deformation = edges->deformation.data();
+
+        const __m128d v_tear_at = _mm_set1_pd(tear_at);
+        const __m128d v_deform_at = _mm_set1_pd(deform_at);
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d half = _mm_set1_pd(0.5);
+        alignas(16) double f_x[2], f_y[2], dv_x[2], dv_y[2];
+        bool tear = false;
+
+        auto gather = [](const double *a, const uint *idx) { return _mm_set_pd(a[idx[1]], a[idx[0]]); };
+
+        uint i = begin;
+        for (; i + 2 <= end; i += 2)
+        {
+            __m128d d_old = _mm_loadu_pd(deformation + i);
+            __m128d torn = _mm_cmpgt_pd(d_old, v_tear_at);
+            if (_mm_movemask_pd(torn))
+                tear = true;
+            __m128d deform = _mm_andnot_pd(torn, _mm_cmpgt_pd(d_old, v_deform_at));
+            __m128d r = _mm_add_pd(_mm_loadu_pd(rest + i), _mm_and_pd(deform, d_old));
+            _mm_storeu_pd(rest + i, r);
+
+            __m128d dx = _mm_sub_pd(gather(x, n2 + i), gather(x, n1 + i));
+            __m128d dy = _mm_sub_pd(gather(y, n2 + i), gather(y, n1 + i));
+            __m128d len_sq = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+            __m128d dist = _mm_sqrt_pd(len_sq);
+            __m128d d_new = _mm_sub_pd(dist, r);
+            _mm_storeu_pd(deformation + i, _mm_or_pd(_mm_and_pd(torn, d_old), _mm_andnot_pd(torn, d_new)));
+
+            __m128d active = _mm_andnot_pd(torn, _mm_cmpneq_pd(dist, zero));
+            __m128d scale = _mm_and_pd(active, _mm_div_pd(_mm_mul_pd(d_new, _mm_loadu_pd(k + i)), dist));
+            _mm_store_pd(f_x, _mm_mul_pd(dx, scale));
+            _mm_store_pd(f_y, _mm_mul_pd(dy, scale));
+
+            __m128d rvx = _mm_sub_pd(gather(vx, n2 + i), gather(vx, n1 + i));
+            __m128d rvy = _mm_sub_pd(gather(vy, n2 + i), gather(vy, n1 + i));
+            __m128d dot = _mm_add_pd(_mm_mul_pd(rvx, dx), _mm_mul_pd(rvy, dy));
+            __m128d proj = _mm_and_pd(active, _mm_div_pd(dot, len_sq));
+            __m128d damp = _mm_mul_pd(_mm_loadu_pd(c + i), half);
+            _mm_store_pd(dv_x, _mm_mul_pd(_mm_mul_pd(dx, proj), damp));
+            _mm_store_pd(dv_y, _mm_mul_pd(_mm_mul_pd(dy, proj), damp));
+
+            scatter(nodes, n1 + i, n2 + i, 2, f_x, f_y, dv_x, dv_y);
+        }
+
+        if (i < end && apply_scalar(edges, nodes, i, end, deform_at, tear_at))
+            tear = true;
+        return tear;
+    }
+#endif
+
+    typedef bool (*apply_fn)(EdgeTable *edges, NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at);
+
+    inline implementation detect()
+    {
+#if defined(SPRING_KERNEL_X86) && DIMENSIONS == 2
+        if (__builtin_cpu_supports("avx2"))
+            return KERNEL_AVX2;
+        return KERNEL_SSE2;
+#else
+        return KERNEL_SCALAR;
+#endif
+    }
+
+    inline implementation &selected()
+    {
+        static implementation impl = detect();
+        return impl;
+    }
+
+    // Chooses the kernel used by apply, KERNEL_AUTO picks the fastest one the cpu supports.
+    // Returns false if the requested kernel isn't available on this cpu or build.
+    inline bool set_implementation(implementation impl)
+    {
+        if (impl == KERNEL_AUTO)
+            impl = detect();
+        if (impl > detect())
+            return false;
+        selected() = impl;
+        return true;
+    }
+
+    inline implementation get_implementation()
+    {
+        return selected();
+    }
+
+    inline const char *get_implementation_name()
+    {
+        const char *names[] = {"scalar", "sse2", "avx2"};
+        return names[selected()];
+    }
+
+    // Same as EdgeTable::apply_forces, but the edges in [begin, end) must not share nodes with each other.
+    inline bool apply(EdgeTable *edges, NodeStore *nodes, uint begin, uint end, double deform_at, double tear_at)
+    {
+        switch (selected())
+        {
+#if defined(SPRING_KERNEL_X86) && DIMENSIONS == 2
+        case KERNEL_AVX2:
+            return apply_avx2(edges, nodes, begin, end, deform_at, tear_at);
+        case KERNEL_SSE2:
+            return apply_sse2(edges, nodes, begin, end, deform_at, tear_at);
+#endif
+        default:
+            return apply_scalar(edges, nodes, begin, end, deform_at, tear_at);
+        }
+    }
+}
+
+#endif
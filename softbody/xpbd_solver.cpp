@@ -0,0 +1,268 @@
+#include <bits/stdc++.h>
+#include "../utils/vectors.cpp"
+
+#include "node.h"
+#include "edge.h"
+
+#ifndef SOFTBODY_XPBD_SOLVER_CC_
+#define SOFTBODY_XPBD_SOLVER_CC_
+
+using namespace std;
+
+// Extended position based dynamics (XPBD). A step is split into substeps, each substep predicts positions from
+// the velocities and the external forces, then projects the positions onto the constraints and derives the
+// velocities from the corrections.
+//
+// Every edge is a distance constraint |x2 - x1| = rest_length with compliance 1 / spring_coef, so stiff springs
+// cost the same as soft ones and never blow up. Walls are inequality constraints that keep the nodes inside a box,
+// with position based friction. Edges are projected one color at a time, edges of a color share no nodes.
+class XpbdSolver {
+    public:
+        uint substeps = 10;
+        // constraint projections per substep
+        uint iterations = 1;
+
+        // nodes are kept inside [lower, upper]
+        vec_t lower;
+        vec_t upper;
+        double bounce_coef = 0;
+        double friction_coef = 0;
+
+        vector<double> previous[DIMENSIONS];
+        vector<double> start_velocity[DIMENSIONS];
+        // accumulated constraint impulse of each edge within a substep
+        vector<double> lambda;
+
+        XpbdSolver()
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                this->lower[d] = -numeric_limits<double>::infinity();
+                this->upper[d] = numeric_limits<double>::infinity();
+            }
+        }
+
+        // sizes the scratch arrays, only allocates when the body grew
+        void resize(uint node_count, uint edge_count)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                this->previous[d].resize(node_count);
+                this->start_velocity[d].resize(node_count);
+            }
+            this->lambda.resize(edge_count);
+        }
+
+        // Applies plastic deformation to edges [begin, end) like EdgeTable::apply_forces.
+        // Returns true if any edge should be torn, torn edges are skipped by the projections.
+        bool begin_edges(EdgeTable *edges, uint begin, uint end, double deform_at, double tear_at)
+        {
+            bool tear = false;
+            for (uint i = begin; i < end; i++)
+            {
+                if (edges->deformation[i] > tear_at)
+                    tear = true;
+                else if (edges->deformation[i] > deform_at)
+                    edges->rest_length[i] += edges->deformation[i];
+            }
+            return tear;
+        }
+
+        // Remembers the velocities at the start of the step of nodes [begin, end).
+        void begin_nodes(NodeStore *nodes, uint begin, uint end)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+                copy(nodes->velocity[d].begin() + begin, nodes->velocity[d].begin() + end, this->start_velocity[d].begin() + begin);
+        }
+
+        // Moves nodes [begin, end) by their velocities after adding the external, gravity and pull forces.
+        void predict(NodeStore *nodes, uint begin, uint end, double h, vec_t external_force)
+        {
+            const double *im = nodes->inv_mass.data();
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                double *p = nodes->position[d].data();
+                double *v = nodes->velocity[d].data();
+                double *prev = this->previous[d].data();
+                const double *f_gravity = nodes->slot_force[FORCE_GRAVITY][d].data();
+                const double *f_pull = nodes->slot_force[FORCE_PULL][d].data();
+                double f_ext = external_force[d];
+                for (uint i = begin; i < end; i++)
+                {
+                    v[i] += (f_ext + f_gravity[i] + f_pull[i]) * im[i] * h;
+                    prev[i] = p[i];
+                    p[i] += v[i] * h;
+                }
+            }
+        }
+
+        // One projection of the distance constraints of edges [begin, end), the edges must not share nodes
+        // unless they run on one thread.
+        void project_edges(NodeStore *nodes, EdgeTable *edges, uint begin, uint end, double h, double tear_at)
+        {
+            const uint *node1 = edges->node1.data(), *node2 = edges->node2.data();
+            const double *spring_coef = edges->spring_coef.data(), *rest_length = edges->rest_length.data();
+            const double *deformation = edges->deformation.data();
+            const double *im = nodes->inv_mass.data();
+            double *lambda = this->lambda.data();
+            double *p[DIMENSIONS];
+            for (uint d = 0; d < DIMENSIONS; d++)
+                p[d] = nodes->position[d].data();
+
+            double inv_h_sq = 1 / (h * h);
+            for (uint i = begin; i < end; i++)
+            {
+                if (deformation[i] > tear_at || spring_coef[i] <= 0)
+                    continue;
+
+                uint n1 = node1[i];
+                uint n2 = node2[i];
+                double w = im[n1] + im[n2];
+
+                double relative_p[DIMENSIONS];
+                double distance_sq = 0;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    relative_p[d] = p[d][n2] - p[d][n1];
+                    distance_sq += relative_p[d] * relative_p[d];
+                }
+                double distance = sqrt(distance_sq);
+                if (distance == 0)
+                    continue;
+
+                double constraint = distance - rest_length[i];
+                double alpha = inv_h_sq / spring_coef[i];
+                double d_lambda = (-constraint - alpha * lambda[i]) / (w + alpha);
+                lambda[i] += d_lambda;
+
+                double scale = d_lambda / distance;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    double correction = relative_p[d] * scale;
+                    p[d][n1] -= im[n1] * correction;
+                    p[d][n2] += im[n2] * correction;
+                }
+            }
+        }
+
+        // Pushes nodes [begin, end) back inside the box. The tangential movement of a node in contact is cut by
+        // friction_coef times the penetration depth.
+        void project_contacts(NodeStore *nodes, uint begin, uint end)
+        {
+            double *p[DIMENSIONS], *prev[DIMENSIONS];
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                p[d] = nodes->position[d].data();
+                prev[d] = this->previous[d].data();
+            }
+
+            for (uint i = begin; i < end; i++)
+            {
+                for (uint a = 0; a < DIMENSIONS; a++)
+                {
+                    double penetration;
+                    if (p[a][i] < this->lower[a])
+                        penetration = this->lower[a] - p[a][i];
+                    else if (p[a][i] > this->upper[a])
+                        penetration = p[a][i] - this->upper[a];
+                    else
+                        continue;
+                    p[a][i] = min(max(p[a][i], this->lower[a]), this->upper[a]);
+
+                    // friction against the movement along the wall during this substep
+                    double tangential_sq = 0;
+                    for (uint d = 0; d < DIMENSIONS; d++)
+                        if (d != a)
+                            tangential_sq += (p[d][i] - prev[d][i]) * (p[d][i] - prev[d][i]);
+                    if (tangential_sq == 0)
+                        continue;
+                    double cut = min(1., this->friction_coef * penetration / sqrt(tangential_sq));
+                    for (uint d = 0; d < DIMENSIONS; d++)
+                        if (d != a)
+                            p[d][i] -= (p[d][i] - prev[d][i]) * cut;
+                }
+            }
+        }
+
+        // Derives the velocities of nodes [begin, end) from the substep's movement. A node resting on a wall
+        // bounces off it with bounce_coef of the velocity it hit the wall with.
+        void update_velocities(NodeStore *nodes, uint begin, uint end, double h)
+        {
+            double inv_h = 1 / h;
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                const double *p = nodes->position[d].data();
+                const double *prev = this->previous[d].data();
+                double *v = nodes->velocity[d].data();
+                for (uint i = begin; i < end; i++)
+                {
+                    if ((p[i] <= this->lower[d] && v[i] < 0) || (p[i] >= this->upper[d] && v[i] > 0))
+                        v[i] = -v[i] * this->bounce_coef;
+                    else
+                        v[i] = (p[i] - prev[i]) * inv_h;
+                }
+            }
+        }
+
+        // Damps edges [begin, end) like EdgeTable::apply_forces, once per step, and stores their deformation.
+        void finish_edges(NodeStore *nodes, EdgeTable *edges, uint begin, uint end, double tear_at)
+        {
+            const uint *node1 = edges->node1.data(), *node2 = edges->node2.data();
+            const double *damping_coef = edges->damping_coef.data(), *rest_length = edges->rest_length.data();
+            double *deformation = edges->deformation.data();
+            const double *p[DIMENSIONS];
+            double *v[DIMENSIONS];
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                p[d] = nodes->position[d].data();
+                v[d] = nodes->velocity[d].data();
+            }
+
+            for (uint i = begin; i < end; i++)
+            {
+                if (deformation[i] > tear_at)
+                    continue;
+
+                uint n1 = node1[i];
+                uint n2 = node2[i];
+                double relative_p[DIMENSIONS];
+                double distance_sq = 0, along = 0;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    relative_p[d] = p[d][n2] - p[d][n1];
+                    distance_sq += relative_p[d] * relative_p[d];
+                    along += (v[d][n2] - v[d][n1]) * relative_p[d];
+                }
+                deformation[i] = sqrt(distance_sq) - rest_length[i];
+                if (distance_sq == 0)
+                    continue;
+
+                double scale = along / distance_sq * (damping_coef[i] * 1/2);
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    v[d][n1] += relative_p[d] * scale;
+                    v[d][n2] -= relative_p[d] * scale;
+                }
+            }
+        }
+
+        // Sets the acceleration of nodes [begin, end) to the velocity change over the step and the force
+        // accumulator to the matching net force.
+        void finish_nodes(NodeStore *nodes, uint begin, uint end, double time_step)
+        {
+            for (uint d = 0; d < DIMENSIONS; d++)
+            {
+                const double *v = nodes->velocity[d].data();
+                const double *v0 = this->start_velocity[d].data();
+                double *a = nodes->acceleration[d].data();
+                double *f = nodes->force[d].data();
+                for (uint i = begin; i < end; i++)
+                {
+                    a[i] = (v[i] - v0[i]) / time_step;
+                    f[i] = a[i] * nodes->mass[i];
+                }
+            }
+        }
+};
+
+#endif
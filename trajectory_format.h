@@ -0,0 +1,72 @@
+#include <bits/stdc++.h>
+
+#ifndef TRAJECTORY_FORMAT_H_
+#define TRAJECTORY_FORMAT_H_
+
+using namespace std;
+
+// Trajectory files hold the node positions and edges of every recorded frame of a simulation:
+//     header                       trajectory_header_t
+//     chunks                       trajectory_chunk_t, then its frames compressed with zlib
+//     index, footer                trajectory_index_entry_t of every chunk, trajectory_footer_t
+// Positions are rounded to multiples of quantum and stored as the difference to the previous frame. A frame is
+//     frame number                 varint, counts dropped frames too
+//     simulated time               8 byte double, seconds since recording started
+//     walls                        2 doubles, width and height of the simulator's walls
+//     body count, node counts      varints
+//     edges of every body          varint, 0 if unchanged since the previous frame, else 1 + edge count followed by
+//                                  every edge as zigzag varints: its first node less the previous edge's first
+//                                  node, then its second node less its first node
+//     coordinate deltas            zigzag varints, body after body, dimension after dimension
+// The first frame of a chunk and frames whose bodies or node counts changed have the edges of every body and
+// deltas against 0, so every chunk decodes on its own.
+
+// format of the files written by TrajectoryRecorder, bumped whenever it changes
+#define TRAJECTORY_VERSION 2
+#define TRAJECTORY_MAGIC 0x52545342       // "BSTR" in native byte order
+#define TRAJECTORY_CHUNK_MAGIC 0x4b4e4843 // "CHNK"
+#define TRAJECTORY_INDEX_MAGIC 0x58444e49 // "INDX"
+// a chunk ends early once its frames take this many bytes before compression
+#define TRAJECTORY_MAX_CHUNK_BYTES (64u << 20)
+// most frames waiting for the writer, however small they are
+#define TRAJECTORY_MAX_RING_FRAMES 4096
+
+// Start of a trajectory file.
+struct trajectory_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dimensions;
+    uint32_t frames_per_chunk;
+    double quantum;
+};
+
+// Start of a chunk, followed by compressed_size bytes of zlib data that inflate to raw_size bytes of frames.
+struct trajectory_chunk_t
+{
+    uint32_t magic;
+    uint32_t frame_count;
+    uint64_t first_frame;
+    double first_time;
+    uint32_t raw_size;
+    uint32_t compressed_size;
+};
+
+// entry of the chunk index, offset is where the chunk header starts
+struct trajectory_index_entry_t
+{
+    uint64_t first_frame;
+    double first_time;
+    uint64_t offset;
+};
+
+// Last bytes of a closed file, the index is chunk_count entries at index_offset. A file that wasn't closed has
+// no index, its chunks can still be found one after the other from the header.
+struct trajectory_footer_t
+{
+    uint64_t index_offset;
+    uint32_t chunk_count;
+    uint32_t magic;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include <bits/stdc++.h>
+#include <zlib.h>
+#include "trajectory_format.h"
+#include "trajectory_reader.h"
+
+#ifndef TRAJECTORY_READER_CPP_
+#define TRAJECTORY_READER_CPP_
+
+using namespace std;
+
+// reads a varint at *at, false if it runs past end
+static inline bool get_varint(const vector<uint8_t> &raw, size_t *at, uint64_t *out)
+{
+    uint64_t value = 0;
+    for (uint shift = 0; shift < 64 && *at < raw.size(); shift += 7)
+    {
+        uint8_t byte = raw[(*at)++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80)
+        {
+            *out = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool get_bytes(const vector<uint8_t> &raw, size_t *at, void *out, size_t size)
+{
+    if (size > raw.size() - *at)
+        return false;
+    memcpy(out, raw.data() + *at, size);
+    *at += size;
+    return true;
+}
+
+static inline int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// reads the edge after the one whose first node is *node1, see trajectory_format.h
+static inline bool get_edge(const vector<uint8_t> &raw, size_t *at, int64_t *node1, int64_t *node2)
+{
+    uint64_t z1, z2;
+    if (!get_varint(raw, at, &z1) || !get_varint(raw, at, &z2))
+        return false;
+    *node1 += unzigzag(z1);
+    *node2 = *node1 + unzigzag(z2);
+    return true;
+}
+
+TrajectoryReader::TrajectoryReader(const string &path) : file(path)
+{
+    this->ok = this->file.read(&this->header) && this->header.magic == TRAJECTORY_MAGIC
+        && this->header.version == TRAJECTORY_VERSION && this->header.dimensions == DIMENSIONS && find_chunks();
+    if (this->ok && !this->chunks.empty())
+    {
+        this->ok = load_chunk(this->chunks.size() - 1);
+        if (this->ok)
+            this->end_time = this->frames.back().time;
+    }
+}
+
+// Takes the chunks from the index, or walks them from the header when the file has no index.
+bool TrajectoryReader::find_chunks()
+{
+    const char *data = this->file.get_data();
+    size_t size = this->file.get_size();
+    vector<uint64_t> offsets;
+
+    trajectory_footer_t footer;
+    bool indexed = false;
+    if (size >= sizeof(trajectory_header_t) + sizeof(footer))
+    {
+        memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+        indexed = footer.magic == TRAJECTORY_INDEX_MAGIC && footer.index_offset <= size - sizeof(footer)
+            && (size - sizeof(footer) - footer.index_offset) == (uint64_t)footer.chunk_count * sizeof(trajectory_index_entry_t);
+    }
+    if (indexed)
+    {
+        for (uint c = 0; c < footer.chunk_count; c++)
+        {
+            trajectory_index_entry_t entry;
+            memcpy(&entry, data + footer.index_offset + c * sizeof(entry), sizeof(entry));
+            offsets.push_back(entry.offset);
+        }
+    }
+    else
+    {
+        uint64_t offset = sizeof(trajectory_header_t);
+        trajectory_chunk_t chunk;
+        while (offset + sizeof(chunk) <= size)
+        {
+            memcpy(&chunk, data + offset, sizeof(chunk));
+            if (chunk.magic != TRAJECTORY_CHUNK_MAGIC || chunk.compressed_size > size - offset - sizeof(chunk))
+                break;
+            offsets.push_back(offset);
+            offset += sizeof(chunk) + chunk.compressed_size;
+        }
+    }
+
+    for (uint64_t offset : offsets)
+    {
+        trajectory_chunk_t chunk;
+        if (offset + sizeof(chunk) > size)
+            return false;
+        memcpy(&chunk, data + offset, sizeof(chunk));
+        if (chunk.magic != TRAJECTORY_CHUNK_MAGIC || chunk.frame_count == 0 || chunk.compressed_size > size - offset - sizeof(chunk))
+            return false;
+        this->chunks.push_back({offset, this->frame_count, chunk.frame_count, chunk.first_time});
+        this->frame_count += chunk.frame_count;
+    }
+    return true;
+}
+
+// Inflates chunk c and decodes all of its frames once, keeping the positions every TRAJECTORY_SNAPSHOT_INTERVAL
+// frames.
+bool TrajectoryReader::load_chunk(uint c)
+{
+    if ((int)c == this->loaded_chunk)
+        return true;
+    this->loaded_chunk = -1;
+    this->decoded_edges_at.clear();
+
+    trajectory_chunk_t chunk;
+    const char *data = this->file.get_data() + this->chunks[c].offset;
+    memcpy(&chunk, data, sizeof(chunk));
+    this->raw.resize(chunk.raw_size);
+    uLongf raw_size = chunk.raw_size;
+    if (uncompress(this->raw.data(), &raw_size, (const Bytef *)data + sizeof(chunk), chunk.compressed_size) != Z_OK || raw_size != chunk.raw_size)
+        return false;
+
+    this->frames.resize(chunk.frame_count);
+    this->snapshots.clear();
+    size_t at = 0;
+    for (uint f = 0; f < chunk.frame_count; f++)
+    {
+        frame_info_t &info = this->frames[f];
+        uint64_t body_count;
+        if (!get_varint(this->raw, &at, &info.frame) || !get_bytes(this->raw, &at, &info.time, sizeof(double))
+            || !get_bytes(this->raw, &at, info.walls, sizeof(info.walls)) || !get_varint(this->raw, &at, &body_count)
+            || body_count > this->raw.size())
+            return false;
+        info.body_nodes.resize(body_count);
+        for (uint b = 0; b < body_count; b++)
+        {
+            uint64_t n;
+            if (!get_varint(this->raw, &at, &n))
+                return false;
+            info.body_nodes[b] = n;
+        }
+        info.reset = f == 0 || info.body_nodes != this->frames[f - 1].body_nodes;
+
+        info.edges_at.resize(body_count);
+        for (uint b = 0; b < body_count; b++)
+        {
+            size_t list_at = at;
+            uint64_t count_plus_one;
+            if (!get_varint(this->raw, &at, &count_plus_one))
+                return false;
+            if (count_plus_one == 0)
+            {
+                // the edges of the previous frame, which has them unless the bodies changed
+                if (info.reset)
+                    return false;
+                info.edges_at[b] = this->frames[f - 1].edges_at[b];
+                continue;
+            }
+            info.edges_at[b] = list_at;
+            int64_t node1 = 0, node2;
+            for (uint64_t i = 0; i < count_plus_one - 1; i++)
+                if (!get_edge(this->raw, &at, &node1, &node2) || (uint64_t)node1 >= info.body_nodes[b]
+                    || (uint64_t)node2 >= info.body_nodes[b])
+                    return false;
+        }
+
+        info.deltas_at = at;
+        if (!apply_deltas(f, &at))
+            return false;
+        if (f % TRAJECTORY_SNAPSHOT_INTERVAL == 0)
+            this->snapshots.push_back(this->state);
+    }
+
+    this->current = chunk.frame_count - 1;
+    this->loaded_chunk = c;
+    return true;
+}
+
+// Advances the positions from the previous frame of the chunk to frame f, *end is where the frame ends in raw.
+bool TrajectoryReader::apply_deltas(uint f, size_t *end)
+{
+    const frame_info_t &info = this->frames[f];
+    size_t coordinates = accumulate(info.body_nodes.begin(), info.body_nodes.end(), (size_t)0) * DIMENSIONS;
+    if (info.reset)
+        this->state.assign(coordinates, 0);
+
+    size_t at = info.deltas_at;
+    int64_t *state = this->state.data();
+    for (size_t i = 0; i < coordinates; i++)
+    {
+        uint64_t z;
+        if (!get_varint(this->raw, &at, &z))
+            return false;
+        state[i] += unzigzag(z);
+    }
+    *end = at;
+    return true;
+}
+
+bool TrajectoryReader::good()
+{
+    return this->ok;
+}
+
+uint64_t TrajectoryReader::get_frame_count()
+{
+    return this->frame_count;
+}
+
+double TrajectoryReader::get_start_time()
+{
+    return this->chunks.empty() ? 0 : this->chunks[0].first_time;
+}
+
+double TrajectoryReader::get_end_time()
+{
+    return this->end_time;
+}
+
+double TrajectoryReader::get_quantum()
+{
+    return this->header.quantum;
+}
+
+uint64_t TrajectoryReader::find_frame(double time)
+{
+    if (this->chunks.empty())
+        return 0;
+    auto chunk = upper_bound(this->chunks.begin(), this->chunks.end(), time, [](double t, const chunk_t &c) { return t < c.first_time; });
+    uint c = chunk == this->chunks.begin() ? 0 : chunk - this->chunks.begin() - 1;
+    if (!load_chunk(c))
+        return this->chunks[c].first_index;
+
+    auto frame = upper_bound(this->frames.begin(), this->frames.end(), time, [](double t, const frame_info_t &f) { return t < f.time; });
+    uint f = frame == this->frames.begin() ? 0 : frame - this->frames.begin() - 1;
+    return this->chunks[c].first_index + f;
+}
+
+const trajectory_frame_t *TrajectoryReader::read_frame(uint64_t index)
+{
+    if (!this->ok || index >= this->frame_count)
+        return NULL;
+    auto chunk = upper_bound(this->chunks.begin(), this->chunks.end(), index, [](uint64_t i, const chunk_t &c) { return i < c.first_index; });
+    uint c = chunk - this->chunks.begin() - 1;
+    if (!load_chunk(c))
+        return NULL;
+
+    // from the positions at hand when they're between the snapshot and the frame, else from the snapshot
+    uint f = index - this->chunks[c].first_index;
+    uint snapshot = f / TRAJECTORY_SNAPSHOT_INTERVAL;
+    if (this->current > f || this->current < snapshot * TRAJECTORY_SNAPSHOT_INTERVAL)
+    {
+        this->state = this->snapshots[snapshot];
+        this->current = snapshot * TRAJECTORY_SNAPSHOT_INTERVAL;
+    }
+    size_t end;
+    while (this->current < f)
+        if (!apply_deltas(++this->current, &end))
+            return NULL;
+
+    const frame_info_t &info = this->frames[f];
+    trajectory_frame_t *out = &this->frame;
+    out->frame = info.frame;
+    out->time = info.time;
+    out->walls[0] = info.walls[0];
+    out->walls[1] = info.walls[1];
+    out->body_nodes = info.body_nodes;
+    out->positions.resize(this->state.size());
+    double quantum = this->header.quantum;
+    for (size_t i = 0; i < this->state.size(); i++)
+        out->positions[i] = this->state[i] * quantum;
+
+    uint body_count = info.body_nodes.size();
+    out->body_edges.resize(body_count);
+    this->decoded_edges_at.resize(body_count, SIZE_MAX);
+    for (uint b = 0; b < body_count; b++)
+    {
+        if (this->decoded_edges_at[b] == info.edges_at[b])
+            continue;
+        // checked when the chunk was loaded
+        size_t at = info.edges_at[b];
+        uint64_t count_plus_one = 1;
+        int64_t node1 = 0, node2 = 0;
+        get_varint(this->raw, &at, &count_plus_one);
+        vector<uint> &edges = out->body_edges[b];
+        edges.resize(2 * (count_plus_one - 1));
+        for (uint i = 0; i < edges.size(); i += 2)
+        {
+            get_edge(this->raw, &at, &node1, &node2);
+            edges[i] = node1;
+            edges[i + 1] = node2;
+        }
+        this->decoded_edges_at[b] = info.edges_at[b];
+    }
+    return out;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <bits/stdc++.h>
+#include "trajectory_format.h"
+#include "utils/binary_file.cpp"
+#include "utils/vectors.cpp"
+
+#ifndef TRAJECTORY_READER_H_
+#define TRAJECTORY_READER_H_
+
+// a decoded chunk keeps the positions after every this many frames, going back costs at most this many frames
+#define TRAJECTORY_SNAPSHOT_INTERVAL 8
+
+using namespace std;
+
+// One frame of a trajectory, see TrajectoryReader::read_frame.
+struct trajectory_frame_t
+{
+    uint64_t frame;
+    double time;
+    double walls[2];
+    vector<uint> body_nodes;
+    // body after body, dimension after dimension: node i of a body with n nodes whose positions start at offset o
+    // is at positions[o + d * n + i]
+    vector<double> positions;
+    // node index pairs of the edges of every body
+    vector<vector<uint>> body_edges;
+};
+
+// Random access to the frames of a file written by TrajectoryRecorder, see trajectory_format.h. The file is
+// memory-mapped, a frame is found through the chunk index and decoded from the nearest snapshot of its chunk, so
+// reading frames backwards costs about as much as reading them forwards. Files that weren't closed are read up to
+// their last complete chunk.
+class TrajectoryReader
+{
+private:
+    struct chunk_t
+    {
+        uint64_t offset;
+        uint64_t first_index;
+        uint32_t frame_count;
+        double first_time;
+    };
+    struct frame_info_t
+    {
+        uint64_t frame;
+        double time;
+        double walls[2];
+        bool reset;
+        vector<uint> body_nodes;
+        // where the edge list of every body last given in the chunk starts in raw
+        vector<size_t> edges_at;
+        size_t deltas_at;
+    };
+
+    utils::BinaryReader file;
+    trajectory_header_t header;
+    bool ok = false;
+    vector<chunk_t> chunks;
+    uint64_t frame_count = 0;
+    double end_time = 0;
+
+    // the inflated chunk, its frames and the quantized positions after every TRAJECTORY_SNAPSHOT_INTERVAL-th frame
+    int loaded_chunk = -1;
+    vector<uint8_t> raw;
+    vector<frame_info_t> frames;
+    vector<vector<int64_t>> snapshots;
+    // quantized positions after frame current of the loaded chunk
+    vector<int64_t> state;
+    uint current = 0;
+
+    trajectory_frame_t frame;
+    // raw offsets of the edge lists in frame.body_edges, they're only decoded again when they change
+    vector<size_t> decoded_edges_at;
+
+    bool find_chunks();
+    bool load_chunk(uint c);
+    bool apply_deltas(uint f, size_t *end);
+
+public:
+    TrajectoryReader(const string &path);
+
+    // false if the file couldn't be mapped or isn't a trajectory of this version
+    bool good();
+    uint64_t get_frame_count();
+    double get_start_time();
+    double get_end_time();
+    double get_quantum();
+
+    // index of the last frame at or before time, the first frame for earlier times
+    uint64_t find_frame(double time);
+    // Frame at index, 0 being the first frame of the file. The frame stays valid until the next call, NULL past
+    // the end or for a damaged chunk.
+    const trajectory_frame_t *read_frame(uint64_t index);
+};
+
+#endif
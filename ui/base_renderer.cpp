@@ -1,5 +1,5 @@
 #include <bits/stdc++.h>
-#include "renderers.h"
+#include "base_renderer.h"
 
 #ifndef UI_DRAWING_CPP_
 #define UI_DRAWING_CPP_
@@ -13,9 +13,17 @@ _BaseRenderer::_BaseRenderer(double width_m, double height_m) {
 }
 
 void _BaseRenderer::begin() {};
-void _BaseRenderer::add_line(vector<double> pos1, vector<double> pos2, double width, color_t color) {};
-void _BaseRenderer::add_circle(vector<double> pos, double radius, color_t color) {};
-void _BaseRenderer::add_rectangle(vector<double> pos1, double width, double height, color_t color) {};
+void _BaseRenderer::add_line(vec_t pos1, vec_t pos2, double width, color_t color) {};
+void _BaseRenderer::add_circle(vec_t pos, double radius, color_t color) {};
+void _BaseRenderer::add_lines(utils::span<vec_t> positions, utils::span<uint> ends, style_t style) {
+    for (size_t e = 0; e + 1 < ends.size(); e += 2)
+        this->add_line(positions[ends[e]], positions[ends[e + 1]], style.line_width, style.color);
+};
+void _BaseRenderer::add_circles(utils::span<vec_t> centers, double radius, style_t style) {
+    for (const vec_t &center : centers)
+        this->add_circle(center, radius, style.color);
+};
+void _BaseRenderer::add_rectangle(vec_t pos1, double width, double height, color_t color) {};
 void _BaseRenderer::render() {};
 void _BaseRenderer::quit() {};
 
@@ -0,0 +1,43 @@
+#include <bits/stdc++.h>
+#include "../utils/vectors.cpp"
+#include "../utils/profiler.cpp"
+#include "../utils/span.cpp"
+#include "draw_list.cpp"
+
+#ifndef UI_BASE_RENDERER_H_
+#define UI_BASE_RENDERER_H_
+
+#define WIDTH 900
+#define HEIGHT 900
+
+using namespace std;
+using utils::vectors::vec_t;
+
+class _BaseRenderer
+{
+protected:
+    uint dsp_w_px;
+    uint dsp_h_px;
+    double dsp_w_m;
+    double dsp_h_m;
+
+public:
+    double m_to_px;
+    typedef DrawList::color_t color_t;
+    typedef DrawList::style_t style_t;
+    _BaseRenderer();
+    _BaseRenderer(double width_m, double height_m);
+
+    virtual void begin();
+    virtual void add_line(vec_t pos1, vec_t pos2, double width, color_t color);
+    virtual void add_circle(vec_t pos, double radius, color_t color);
+    // Batched primitives, lines from positions[ends[2 * i]] to positions[ends[2 * i + 1]] and circles of one
+    // radius. Backends that batch draw them in one go at render, the others as single lines and circles.
+    virtual void add_lines(utils::span<vec_t> positions, utils::span<uint> ends, style_t style);
+    virtual void add_circles(utils::span<vec_t> centers, double radius, style_t style);
+    virtual void add_rectangle(vec_t pos1, double width, double height, color_t color);
+    virtual void render();
+    virtual void quit();
+};
+
+#endif
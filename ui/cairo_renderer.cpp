@@ -2,7 +2,7 @@
 #include <cairo/cairo-xlib.h>
 #include <X11/Xlib.h>
 #include "../utils/vectors.cpp"
-#include "renderers.h"
+#include "cairo_renderer.h"
 
 #ifndef UI_CAIRO_RENDERER_CPP_
 #define UI_CAIRO_RENDERER_CPP_
@@ -64,10 +64,22 @@ CairoRenderer::CairoRenderer(double width_m, double height_m) : _BaseRenderer()
     this->srfc = get<1>(t2);
 }
 
-void CairoRenderer::begin() { cairo_push_group(this->cr); }
-void CairoRenderer::add_line(vector<double> pos1, vector<double> pos2, double width, color_t color) {
-    pos1 = scale_vector(pos1, this->m_to_px);
-    pos2 = scale_vector(pos2, this->m_to_px);
+CairoRenderer::CairoRenderer(double width_m, double height_m, cairo_surface_t *surface) : _BaseRenderer() {
+    this->dsp_w_m = width_m;
+    this->dsp_h_m = height_m;
+    this->m_to_px = cairo_image_surface_get_width(surface) / width_m;
+    this->srfc = surface;
+    this->cr = cairo_create(surface);
+}
+
+void CairoRenderer::begin() {
+    this->draw_list.clear();
+    cairo_push_group(this->cr);
+}
+void CairoRenderer::add_line(vec_t pos1, vec_t pos2, double width, color_t color) {
+    draw_batches();
+    pos1 *= this->m_to_px;
+    pos2 *= this->m_to_px;
     width *= this->m_to_px;
 
     cairo_set_source_rgb(this->cr, color.r / 255.0, color.g / 255.0, color.b / 255.0);
@@ -77,8 +89,9 @@ void CairoRenderer::add_line(vector<double> pos1, vector<double> pos2, double wi
     cairo_stroke(this->cr);
 };
 
-void CairoRenderer::add_rectangle(vector<double> pos, double width, double height, color_t color) {
-    pos = scale_vector(pos, this->m_to_px);
+void CairoRenderer::add_rectangle(vec_t pos, double width, double height, color_t color) {
+    draw_batches();
+    pos *= this->m_to_px;
     width *= this->m_to_px;
     height *= this->m_to_px;
 
@@ -87,8 +100,9 @@ void CairoRenderer::add_rectangle(vector<double> pos, double width, double heigh
     cairo_fill(this->cr);
 };
 
-void CairoRenderer::add_circle(vector<double> pos, double r, color_t color) {
-    pos = scale_vector(pos, this->m_to_px);
+void CairoRenderer::add_circle(vec_t pos, double r, color_t color) {
+    draw_batches();
+    pos *= this->m_to_px;
     r *= this->m_to_px;
 
     cairo_set_source_rgb(this->cr, color.r / 255.0, color.g / 255.0, color.b / 255.0);
@@ -96,15 +110,74 @@ void CairoRenderer::add_circle(vector<double> pos, double r, color_t color) {
     cairo_fill(this->cr);
 }
 
+void CairoRenderer::add_lines(utils::span<vec_t> positions, utils::span<uint> ends, style_t style) {
+    this->draw_list.add_lines(positions, ends, style);
+}
+
+void CairoRenderer::add_circles(utils::span<vec_t> centers, double radius, style_t style) {
+    this->draw_list.add_circles(centers, radius, style);
+}
+
+// Every batch is one path, stroked or filled once, instead of a path per primitive.
+void CairoRenderer::draw_batches() {
+    const vec_t *points = this->draw_list.get_points();
+    for (const DrawList::batch_t &batch : this->draw_list.get_batches())
+    {
+        const color_t &color = batch.style.color;
+        cairo_set_source_rgb(this->cr, color.r / 255.0, color.g / 255.0, color.b / 255.0);
+        cairo_new_path(this->cr);
+        if (batch.kind == DrawList::LINES)
+        {
+            for (size_t i = batch.begin; i + 1 < batch.end; i += 2)
+            {
+                cairo_move_to(this->cr, points[i][0] * this->m_to_px, points[i][1] * this->m_to_px);
+                cairo_line_to(this->cr, points[i + 1][0] * this->m_to_px, points[i + 1][1] * this->m_to_px);
+            }
+            cairo_set_line_width(this->cr, batch.style.line_width * this->m_to_px);
+            cairo_stroke(this->cr);
+        }
+        else
+        {
+            double r = batch.radius * this->m_to_px;
+            for (size_t i = batch.begin; i < batch.end; i++)
+            {
+                cairo_new_sub_path(this->cr);
+                cairo_arc(this->cr, points[i][0] * this->m_to_px, points[i][1] * this->m_to_px, r, 0, 2 * M_PI);
+            }
+            if (batch.style.line_width > 0)
+            {
+                cairo_set_line_width(this->cr, batch.style.line_width * this->m_to_px);
+                cairo_stroke(this->cr);
+            }
+            else
+                cairo_fill(this->cr);
+        }
+    }
+    this->draw_list.clear();
+}
+
 void CairoRenderer::render() {
+    PROFILE_SCOPE("CairoRenderer::render");
+    draw_batches();
     cairo_pop_group_to_source(this->cr);
     cairo_paint(this->cr);
     cairo_surface_flush(this->srfc);
-    XFlush(this->dsp);
+    if (this->dsp != NULL)
+        XFlush(this->dsp);
 };
 
+// Releases the context. The window's surface is released with it, a surface passed in stays the caller's.
 void CairoRenderer::quit() {
-    XCloseDisplay(this->dsp);
+    if (this->cr != NULL)
+        cairo_destroy(this->cr);
+    this->cr = NULL;
+    if (this->dsp != NULL)
+    {
+        cairo_surface_destroy(this->srfc);
+        this->srfc = NULL;
+        XCloseDisplay(this->dsp);
+        this->dsp = NULL;
+    }
 }
 
 #endif
\ No newline at end of file
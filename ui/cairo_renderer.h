@@ -0,0 +1,45 @@
+#include <bits/stdc++.h>
+#include <cairo/cairo.h>
+#include <X11/Xlib.h>
+#include "base_renderer.h"
+
+#ifndef UI_CAIRO_RENDERER_H_
+#define UI_CAIRO_RENDERER_H_
+
+using namespace std;
+
+class CairoRenderer : public _BaseRenderer
+{
+protected:
+    tuple<Display *, Drawable, int> init_x11(int w, int h);
+    cairo_surface_t *init_cairo(Display *dsp, Drawable da, int screen, int x, int y);
+    tuple<cairo_t *, cairo_surface_t *> init_surface(Display *dsp, Drawable drw, int screen);
+    cairo_t *cr = NULL;
+    cairo_surface_t *srfc = NULL;
+    int screen;
+    // batched primitives not drawn yet, drawn before the next single primitive and at render
+    DrawList draw_list;
+
+    void draw_batches();
+
+public:
+    // NULL when drawing offscreen
+    Display *dsp = NULL;
+    double m_to_px;
+
+    CairoRenderer();
+    CairoRenderer(double width_m, double height_m);
+    // draws into surface, like an image surface, without a window. quit releases the context, the caller still
+    // owns surface
+    CairoRenderer(double width_m, double height_m, cairo_surface_t *surface);
+    void begin();
+    void add_line(vec_t pos1, vec_t pos2, double width, color_t color);
+    void add_rectangle(vec_t pos, double width, double height, color_t color);
+    void add_circle(vec_t pos, double r, color_t color);
+    void add_lines(utils::span<vec_t> positions, utils::span<uint> ends, style_t style);
+    void add_circles(utils::span<vec_t> centers, double radius, style_t style);
+    void render();
+    void quit();
+};
+
+#endif
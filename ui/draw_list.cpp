@@ -0,0 +1,115 @@
+#include <bits/stdc++.h>
+#include "../utils/vectors.cpp"
+#include "../utils/span.cpp"
+
+#ifndef UI_DRAW_LIST_CPP_
+#define UI_DRAW_LIST_CPP_
+
+using namespace std;
+using utils::vectors::vec_t;
+
+// Primitives of a frame in the order they were added, grouped into batches of one kind, style and radius so that a
+// backend can draw each batch at once. Consecutive additions with the same kind, style and radius go into the same
+// batch. The points of a batch are kept contiguous, line batches hold the two ends of every line one after the
+// other, circle batches their centers. clear keeps the capacity, a frame drawing no more than the frames before
+// allocates nothing.
+class DrawList
+{
+public:
+    struct color_t
+    {
+        uint8_t r, g, b;
+        double a;
+    };
+
+    struct style_t
+    {
+        color_t color;
+        // stroke width in meters, 0 fills circles
+        double line_width;
+    };
+
+    enum primitive_t
+    {
+        LINES,
+        CIRCLES
+    };
+
+    struct batch_t
+    {
+        primitive_t kind;
+        style_t style;
+        double radius;
+        // points[begin] up to points[end]
+        size_t begin, end;
+    };
+
+private:
+    vector<vec_t> points;
+    vector<batch_t> batches;
+
+    // the batch the next count points go to, a new one unless the last batch matches
+    batch_t &batch_for(primitive_t kind, const style_t &style, double radius)
+    {
+        if (!this->batches.empty())
+        {
+            batch_t &last = this->batches.back();
+            const color_t &c = last.style.color;
+            if (last.kind == kind && last.radius == radius && last.style.line_width == style.line_width
+                && c.r == style.color.r && c.g == style.color.g && c.b == style.color.b && c.a == style.color.a)
+                return last;
+        }
+        this->batches.push_back({kind, style, radius, this->points.size(), this->points.size()});
+        return this->batches.back();
+    }
+
+public:
+    void clear()
+    {
+        this->points.clear();
+        this->batches.clear();
+    }
+
+    // lines from positions[ends[2 * i]] to positions[ends[2 * i + 1]]
+    void add_lines(utils::span<vec_t> positions, utils::span<uint> ends, const style_t &style)
+    {
+        if (ends.size() < 2)
+            return;
+        batch_t &batch = batch_for(LINES, style, 0);
+        size_t first = this->points.size();
+        this->points.resize(first + ends.size() / 2 * 2);
+        vec_t *out = this->points.data() + first;
+        for (size_t e = 0; e + 1 < ends.size(); e += 2, out += 2)
+        {
+            out[0] = positions[ends[e]];
+            out[1] = positions[ends[e + 1]];
+        }
+        batch.end = this->points.size();
+    }
+
+    void add_circles(utils::span<vec_t> centers, double radius, const style_t &style)
+    {
+        if (centers.empty())
+            return;
+        batch_t &batch = batch_for(CIRCLES, style, radius);
+        this->points.insert(this->points.end(), centers.begin(), centers.end());
+        batch.end = this->points.size();
+    }
+
+    const vector<batch_t> &get_batches()
+    {
+        return this->batches;
+    }
+
+    const vec_t *get_points()
+    {
+        return this->points.data();
+    }
+
+    size_t get_point_count()
+    {
+        return this->points.size();
+    }
+};
+
+#endif
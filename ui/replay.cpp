@@ -0,0 +1,271 @@
+#include <bits/stdc++.h>
+#include <thread>
+#include <chrono>
+#include <X11/Xlib.h>
+#include "renderers.h"
+#include "../trajectory_reader.h"
+#include "../utils/vectors.cpp"
+#include "../utils/arena.cpp"
+
+#ifndef UI_REPLAY_CPP_
+#define UI_REPLAY_CPP_
+
+using namespace utils::vectors;
+using namespace std;
+
+// Plays a recorded trajectory back through a renderer, without a simulator. The play position is a time in the
+// recording that moves by the wall time times speed, a negative speed plays backwards. Keys: q quit, space pause,
+// r reverse, up and down double and halve the speed, left and right step one frame, home and end jump to the
+// first and last frame, p prints the profiler summary. Pressing and dragging the mouse scrubs along the progress
+// bar's width.
+template <class _Renderer>
+class Replay
+{
+private:
+    struct
+    {
+        bool is_paused = false;
+        bool quit = false;
+        bool is_scrubbing = false;
+    } state;
+
+    float node_r = 0.04;
+    float edge_w = 0.016;
+    float bar_h = 0.05;
+    double speed = 1;
+    // recorded seconds of the play position
+    double time = 0;
+
+    TrajectoryReader *reader;
+    const trajectory_frame_t *frame = NULL;
+    uint64_t shown_frame = UINT64_MAX;
+    _Renderer renderer;
+
+    // temporaries of the frame being drawn, reset by every pack_frame
+    utils::Arena arena;
+    // the positions and edge nodes of the frame packed for the renderer, body after body, in the arena
+    utils::span<vec_t> positions;
+    utils::span<uint> edge_nodes;
+
+    void pack_frame()
+    {
+        this->arena.reset();
+        size_t node_count = 0, edge_node_count = 0;
+        for (uint b = 0; b < this->frame->body_nodes.size(); b++)
+        {
+            node_count += this->frame->body_nodes[b];
+            edge_node_count += this->frame->body_edges[b].size();
+        }
+        vec_t *positions = this->arena.alloc<vec_t>(node_count);
+        uint *edge_nodes = this->arena.alloc<uint>(edge_node_count);
+
+        size_t offset = 0;
+        uint start = 0;
+        uint *edge_out = edge_nodes;
+        for (uint b = 0; b < this->frame->body_nodes.size(); b++)
+        {
+            uint n = this->frame->body_nodes[b];
+            for (uint i = 0; i < n; i++)
+                for (uint d = 0; d < DIMENSIONS; d++)
+                    positions[start + i][d] = this->frame->positions[offset + d * n + i];
+            for (uint node : this->frame->body_edges[b])
+                *edge_out++ = start + node;
+            offset += (size_t)n * DIMENSIONS;
+            start += n;
+        }
+        this->positions = utils::span<vec_t>(positions, node_count);
+        this->edge_nodes = utils::span<uint>(edge_nodes, edge_node_count);
+    }
+
+public:
+    Replay(TrajectoryReader *reader, double speed = 1)
+    {
+        this->reader = reader;
+        this->speed = speed;
+        this->time = reader->get_start_time();
+        this->frame = reader->read_frame(0);
+        this->shown_frame = 0;
+        if (this->frame != NULL)
+            this->renderer = _Renderer(this->frame->walls[0], this->frame->walls[1]);
+    }
+
+    void draw_bg()
+    {
+        this->renderer.add_rectangle({0, 0}, this->frame->walls[0], this->frame->walls[1], {1, 16, 89, 1});
+    }
+
+    void draw_edges()
+    {
+        this->renderer.add_lines(this->positions, this->edge_nodes, {{93, 196, 255, 1}, this->edge_w});
+    }
+
+    void draw_nodes()
+    {
+        this->renderer.add_circles(this->positions, this->node_r, {{245, 253, 255, 1}, 0});
+    }
+
+    void draw_progress()
+    {
+        double start = this->reader->get_start_time();
+        double duration = max(this->reader->get_end_time() - start, 1e-12);
+        double progress = (this->frame->time - start) / duration;
+        this->renderer.add_rectangle({0, this->frame->walls[1] - this->bar_h}, this->frame->walls[0] * progress,
+                                     this->bar_h, {93, 196, 255, 0.5});
+    }
+
+    void redraw_canvas()
+    {
+        PROFILE_SCOPE("Replay::redraw_canvas");
+        pack_frame();
+        this->renderer.begin();
+        draw_bg();
+        draw_edges();
+        draw_nodes();
+        draw_progress();
+        this->renderer.render();
+    }
+
+    // reads and draws frame index unless it's the one on screen
+    void show_frame(uint64_t index)
+    {
+        if (index == this->shown_frame)
+            return;
+        const trajectory_frame_t *frame = this->reader->read_frame(index);
+        if (frame == NULL)
+            return;
+        this->frame = frame;
+        this->shown_frame = index;
+        redraw_canvas();
+    }
+
+    // pauses on the frame next to the shown one
+    void step_frame(int direction)
+    {
+        this->state.is_paused = true;
+        if ((direction < 0 && this->shown_frame == 0) || (direction > 0 && this->shown_frame + 1 >= this->reader->get_frame_count()))
+            return;
+        show_frame(this->shown_frame + direction);
+        this->time = this->frame->time;
+    }
+
+    void seek(int x)
+    {
+        double start = this->reader->get_start_time();
+        double progress = x / (this->renderer.m_to_px * this->frame->walls[0]);
+        this->time = start + min(max(progress, 0.), 1.) * (this->reader->get_end_time() - start);
+    }
+
+    void _handle_key_press(int k)
+    {
+        switch (k)
+        {
+        case 24:
+            this->state.quit = true;
+            break;
+        case 33:
+            utils::Profiler::print_summary(cout);
+            break;
+        case 65:
+            this->state.is_paused = !this->state.is_paused;
+            // playing on from the end starts over
+            if (!this->state.is_paused && this->speed > 0 && this->time >= this->reader->get_end_time())
+                this->time = this->reader->get_start_time();
+            if (!this->state.is_paused && this->speed < 0 && this->time <= this->reader->get_start_time())
+                this->time = this->reader->get_end_time();
+            break;
+        case 27:
+            this->speed = -this->speed;
+            break;
+        case 111:
+            this->speed *= 2;
+            break;
+        case 116:
+            this->speed /= 2;
+            break;
+        case 113:
+            step_frame(-1);
+            break;
+        case 114:
+            step_frame(1);
+            break;
+        case 110:
+            this->time = this->reader->get_start_time();
+            break;
+        case 115:
+            this->time = this->reader->get_end_time();
+            break;
+        default:
+            break;
+        }
+        cout << "key: " << k << " speed: " << this->speed << (this->state.is_paused ? " (paused)" : "") << endl;
+    }
+
+    void handle_events()
+    {
+        PROFILE_SCOPE("Replay::handle_events");
+        XEvent e;
+        while (XPending(this->renderer.dsp))
+        {
+            XNextEvent(this->renderer.dsp, &e);
+            switch (e.type)
+            {
+            case KeyPress:
+                this->_handle_key_press(e.xkey.keycode);
+                break;
+
+            case ButtonPress:
+                this->state.is_scrubbing = true;
+                this->seek(e.xbutton.x);
+                break;
+
+            case ButtonRelease:
+                this->state.is_scrubbing = false;
+                break;
+
+            case 6:
+                if (this->state.is_scrubbing)
+                    this->seek(e.xmotion.x);
+                break;
+            }
+        }
+    }
+
+    // Moves the play position by the wall time of every frame and draws the frame at it, target_frame_rate times
+    // per second. A frame is only read and drawn when the play position reached another frame, so a paused or slow
+    // replay costs next to nothing. Playing stops at either end.
+    void play(uint target_frame_rate)
+    {
+        using namespace chrono;
+        using namespace this_thread;
+
+        if (this->frame == NULL)
+            return;
+        redraw_canvas();
+
+        duration<double> frame_dur(1. / target_frame_rate);
+        auto last_frame = steady_clock::now();
+        while (this->state.quit == false)
+        {
+            auto frame_start = steady_clock::now();
+            double elapsed_s = duration<double>(frame_start - last_frame).count();
+            last_frame = frame_start;
+
+            this->handle_events();
+            if (!this->state.is_paused && !this->state.is_scrubbing)
+            {
+                this->time += elapsed_s * this->speed;
+                double start = this->reader->get_start_time(), end = this->reader->get_end_time();
+                if (this->time <= start || this->time >= end)
+                    this->state.is_paused = true;
+                this->time = min(max(this->time, start), end);
+            }
+            show_frame(this->reader->find_frame(this->time));
+
+            sleep_until(frame_start + frame_dur);
+        }
+
+        this->renderer.quit();
+    }
+};
+
+#endif
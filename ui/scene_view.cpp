@@ -0,0 +1,82 @@
+#include <bits/stdc++.h>
+#include "../simulator.h"
+#include "../utils/vectors.cpp"
+
+#ifndef UI_SCENE_VIEW_CPP_
+#define UI_SCENE_VIEW_CPP_
+
+using namespace utils::vectors;
+using namespace std;
+
+// The node store and edge table of every body of a simulator, for code working body by body like picking a node.
+// update only rebuilds it when bodies were added or replaced or their node or edge counts changed. For reading
+// every position at once see Simulator::get_positions.
+class SceneView
+{
+public:
+    struct body_view_t
+    {
+        NodeStore *nodes;
+        EdgeTable *edges;
+        uint node_count;
+        uint edge_count;
+    };
+
+private:
+    vector<body_view_t> bodies;
+    size_t node_count = 0;
+    size_t edge_count = 0;
+    uint64_t rebuilds = 0;
+
+public:
+    // true if the view was rebuilt
+    bool update(Simulator *s)
+    {
+        uint body_count = s->get_body_count();
+        bool changed = body_count != this->bodies.size();
+        for (uint b = 0; !changed && b < body_count; b++)
+        {
+            SoftBody *body = s->get_body(b);
+            const body_view_t &view = this->bodies[b];
+            changed = view.nodes != body->get_nodes() || view.edges != body->get_edges()
+                || view.node_count != body->get_nodes()->size() || view.edge_count != body->get_edges()->size();
+        }
+        if (!changed)
+            return false;
+
+        this->bodies.resize(body_count);
+        this->node_count = 0;
+        this->edge_count = 0;
+        for (uint b = 0; b < body_count; b++)
+        {
+            SoftBody *body = s->get_body(b);
+            this->bodies[b] = {body->get_nodes(), body->get_edges(), body->get_nodes()->size(), body->get_edges()->size()};
+            this->node_count += this->bodies[b].node_count;
+            this->edge_count += this->bodies[b].edge_count;
+        }
+        this->rebuilds++;
+        return true;
+    }
+
+    const vector<body_view_t> &get_bodies()
+    {
+        return this->bodies;
+    }
+
+    size_t get_node_count()
+    {
+        return this->node_count;
+    }
+
+    size_t get_edge_count()
+    {
+        return this->edge_count;
+    }
+
+    uint64_t get_rebuilds()
+    {
+        return this->rebuilds;
+    }
+};
+
+#endif
@@ -21,12 +21,12 @@ void TerminalRenderer::update_canvas_size()
     this->m_to_px = (double)min(this->dsp_h_px, this->dsp_w_px) / min(this->dsp_h_m, this->dsp_w_m);
 }
 
-vector<int> TerminalRenderer::floor_pos(vector<double> pos)
+fixed_vector<int, DIMENSIONS> TerminalRenderer::floor_pos(vec_t pos)
 {
-    vector<int> flrd_pos;
-    for (int i = 0; i < pos.size(); i++)
+    fixed_vector<int, DIMENSIONS> flrd_pos;
+    for (uint i = 0; i < pos.size(); i++)
     {
-        flrd_pos.push_back((int)(pos[i] * this->m_to_px));
+        flrd_pos[i] = (int)(pos[i] * this->m_to_px);
     }
     return flrd_pos;
 }
@@ -40,14 +40,14 @@ TerminalRenderer::TerminalRenderer(double width_m, double height_m) : _BaseRende
     // ios_base::sync_with_stdio(false);
 }
 void TerminalRenderer::begin(){}
-void TerminalRenderer::add_line(vector<double> pos1, vector<double> pos2, double width, color_t color)
+void TerminalRenderer::add_line(vec_t pos1, vec_t pos2, double width, color_t color)
 {
     // broken
     return;
-    vector<int> flrd_pos1 = this->floor_pos(pos1);
-    vector<int> flrd_pos2 = this->floor_pos(pos2);
+    fixed_vector<int, DIMENSIONS> flrd_pos1 = this->floor_pos(pos1);
+    fixed_vector<int, DIMENSIONS> flrd_pos2 = this->floor_pos(pos2);
 
-    vector<int> diff = vector_sub<int>(flrd_pos2, flrd_pos1);
+    fixed_vector<int, DIMENSIONS> diff = flrd_pos2 - flrd_pos1;
     int x_diff = diff[0];
     int y_diff = diff[1];
 
@@ -79,7 +79,7 @@ void TerminalRenderer::add_line(vector<double> pos1, vector<double> pos2, double
             line_grow_y = y_diff;
         }
     }
-    vector<int> point_pos = flrd_pos1;
+    fixed_vector<int, DIMENSIONS> point_pos = flrd_pos1;
 
     while (point_pos[0] <= flrd_pos2[0] && point_pos[1] <= flrd_pos2[1])
     {
@@ -105,11 +105,11 @@ void TerminalRenderer::add_line(vector<double> pos1, vector<double> pos2, double
     }
 }
 
-void TerminalRenderer::add_rectangle(vector<double> pos, double width, double height, color_t color) {}
+void TerminalRenderer::add_rectangle(vec_t pos, double width, double height, color_t color) {}
 
-void TerminalRenderer::add_circle(vector<double> pos, double r, color_t color)
+void TerminalRenderer::add_circle(vec_t pos, double r, color_t color)
 {
-    vector<int> flrd_pos = this->floor_pos(pos);
+    fixed_vector<int, DIMENSIONS> flrd_pos = this->floor_pos(pos);
 
     // don't add if outside
     if (0 > flrd_pos[0] || flrd_pos[0] > dsp_w_px+1 || 0 > flrd_pos[1] || flrd_pos[1] > this->dsp_h_px+1)
@@ -125,6 +125,7 @@ void TerminalRenderer::add_circle(vector<double> pos, double r, color_t color)
 
 void TerminalRenderer::render()
 {
+    PROFILE_SCOPE("TerminalRenderer::render");
     //  init blank output
     int w = this->dsp_w_px;
     string empty_line;
@@ -5,6 +5,9 @@
 #include "renderers.h"
 #include "../simulator.h"
 #include "../utils/vectors.cpp"
+#include "../utils/arena.cpp"
+#include "../utils/allocation_counter.cpp"
+#include "scene_view.cpp"
 
 #ifndef UI_UI_CPP_
 #define UI_UI_CPP_
@@ -20,10 +23,12 @@ private:
     {
         bool is_paused = false;
         bool quit = false;
-        Node *node_pulled = NULL;
+        Node node_pulled;
         bool is_pulling = false;
         bool show_nodes = true;
         bool show_edges = true;
+        // force on every node, toggled with v
+        bool show_vectors = false;
     } state;
 
     vector<uint> mouse_pos = {0, 0};
@@ -31,6 +36,23 @@ private:
     float node_r = 0.04;
     float edge_w = 0.02;
     double time_scale = 1;
+    // wall time a frame catches up at most after a hiccup
+    double max_catch_up_s = 0.25;
+    bool unthrottled = false;
+
+    // measured over the last second of simulation_auto_run
+    struct
+    {
+        double steps_per_s = 0;
+        double frame_rate = 0;
+        double frame_jitter_ms = 0;
+        double allocations_per_frame = 0;
+    } run_stats;
+
+    // temporaries of the frame being drawn, reset at the start of every frame
+    utils::Arena arena;
+    // bodies of the simulator as drawn, see SceneView::update
+    SceneView view;
 
     Node pulled_node;
     Node highlighted_node;
@@ -58,19 +80,8 @@ public:
         if (this->state.show_edges == false)
             return;
 
-        Node *n1, *n2;
-        vector<double> pos1, pos2;
-        vector<Edge *> es;
-        this->simulator->get_all_edges(&es);
-
-        for (auto e : es)
-        {
-            n1 = e->get_node1();
-            n2 = e->get_node2();
-            pos1 = n1->get_position();
-            pos2 = n2->get_position();
-            this->renderer.add_line(pos1, pos2, 0.016, {93, 196, 255, 1});
-        }
+        this->renderer.add_lines(this->simulator->get_positions(), this->simulator->get_edge_nodes(),
+                                 {{93, 196, 255, 1}, 0.016});
     }
     void draw_nodes()
     {
@@ -78,28 +89,33 @@ public:
         {
             return;
         }
-        vector<Node *> nodes;
-        this->simulator->get_all_nodes(&nodes);
-        for (auto n : nodes)
-            this->renderer.add_circle(n->get_position(), this->node_r, {245, 253, 255, 1});
+        this->renderer.add_circles(this->simulator->get_positions(), this->node_r, {{245, 253, 255, 1}, 0});
     }
 
+    // the force on every node as a line, gathered in the arena and drawn as one batch
     void draw_vectors()
     {
-        vector<Node *> nodes;
-        this->simulator->get_all_nodes(&nodes);
-        vector<double> pos;
-        vector<double> f;
-        vector<double> end_pos;
-        for (auto n : nodes)
-        {
-            pos = n->get_position();
-            f = n->force_sum();
-            if (vector_len(f) < 0.1)
-                continue;
-            end_pos = vector_sum(pos, scale_vector(f, 0.5));
-            this->renderer.add_line(pos, end_pos, this->edge_w, {0, 100, 255, 1});
-        }
+        if (this->state.show_vectors == false)
+            return;
+
+        vec_t *ends = this->arena.alloc<vec_t>(2 * this->view.get_node_count());
+        uint *indices = this->arena.alloc<uint>(2 * this->view.get_node_count());
+        uint count = 0;
+        for (const SceneView::body_view_t &body : this->view.get_bodies())
+            for (uint i = 0; i < body.node_count; i++)
+            {
+                Node n = Node(body.nodes, i);
+                vec_t f = n.force_sum();
+                if (vector_len(f) < 0.1)
+                    continue;
+                ends[count] = n.get_position();
+                ends[count + 1] = ends[count] + f * 0.5;
+                indices[count] = count;
+                indices[count + 1] = count + 1;
+                count += 2;
+            }
+        this->renderer.add_lines(utils::span<vec_t>(ends, count), utils::span<uint>(indices, count),
+                                 {{0, 100, 255, 1}, this->edge_w});
     }
 
     void draw_bg()
@@ -109,34 +125,34 @@ public:
 
     void redraw_canvas()
     {
+        PROFILE_SCOPE("Ui::redraw_canvas");
+        this->view.update(this->simulator);
         this->renderer.begin();
         draw_bg();
         draw_edges();
         draw_nodes();
-        // draw_vectors();
+        draw_vectors();
         this->renderer.render();
     }
 
     void _handle_mouse_press(int x, int y)
     {
-        vector<Node *> nodes;
-        this->simulator->get_all_nodes(&nodes);
+        this->view.update(this->simulator);
 
         this->state.is_pulling = false;
-        for (auto n : nodes)
-        {
-            auto pos = n->get_position();
-            auto nx = (int)(pos[0] * this->renderer.m_to_px);
-            auto ny = (int)(pos[1] * this->renderer.m_to_px);
-            int click_r = 30;
-
-            if (nx - click_r < x && x < nx + click_r && ny - click_r < y && y < ny + click_r)
+        for (const SceneView::body_view_t &body : this->view.get_bodies())
+            for (uint i = 0; i < body.node_count && !this->state.is_pulling; i++)
             {
-                this->state.node_pulled = n;
-                this->state.is_pulling = true;
-                break;
+                auto nx = (int)(body.nodes->position[0][i] * this->renderer.m_to_px);
+                auto ny = (int)(body.nodes->position[1][i] * this->renderer.m_to_px);
+                int click_r = 30;
+
+                if (nx - click_r < x && x < nx + click_r && ny - click_r < y && y < ny + click_r)
+                {
+                    this->state.node_pulled = Node(body.nodes, i);
+                    this->state.is_pulling = true;
+                }
             }
-        }
     }
 
     void _handle_key_press(int k)
@@ -147,15 +163,25 @@ public:
         case 24:
             this->state.quit = true;
             break;
+        case 33:
+            utils::Profiler::print_summary(cout);
+            break;
         case 27:
             this->running_simulator = &*this->simulator;
             break;
+        case 41:
+            this->unthrottled = !this->unthrottled;
+            break;
+        case 55:
+            this->state.show_vectors = !this->state.show_vectors;
+            break;
         default:
             break;
         }
     }
     void handle_events()
     {
+        PROFILE_SCOPE("Ui::handle_events");
         XEvent e;
         this->pull_node(this->mouse_pos[0], this->mouse_pos[1]);
 
@@ -186,46 +212,115 @@ public:
     void pull_node(int x, int y)
     {
         if (this->state.is_pulling != true) {
-            if (this->state.node_pulled != NULL)
-                this->state.node_pulled->set_force("pull", {0,0});
+            if (this->state.node_pulled.is_valid())
+                this->state.node_pulled.set_force(FORCE_PULL, {0,0});
             return;
         }
         double nx = x / this->renderer.m_to_px;
         double ny = y / this->renderer.m_to_px;
-        auto node_p = this->state.node_pulled->get_position();
-        vector<double> pull_f = scale_vector<double>({nx - node_p[0], ny - node_p[1]}, 100*this->state.node_pulled->get_mass());
-        this->state.node_pulled->set_force("pull", pull_f);
+        auto node_p = this->state.node_pulled.get_position();
+        vec_t pull_f = vec_t{nx - node_p[0], ny - node_p[1]} * (100*this->state.node_pulled.get_mass());
+        this->state.node_pulled.set_force(FORCE_PULL, pull_f);
     }
 
-    void simulation_auto_run(int time_step_ms, uint8_t target_frame_rate)
+    // Runs the simulation with fixed steps of time_step_ms simulated time, drawing target_frame_rate frames per
+    // second. The wall time of each frame goes into an accumulator that is paid off in whole steps, one step
+    // being time_step_ms / time_scale of wall time. After a hiccup at most max_catch_up_s of wall time is caught
+    // up, the rest is dropped. Unthrottled, the simulation steps as fast as it can between frames instead.
+    void simulation_auto_run(double time_step_ms, uint target_frame_rate, bool unthrottled = false)
     {
         using namespace chrono;
         using namespace this_thread;
 
-        int sleep_dur_ms = (time_step_ms / this->time_scale);
-        milliseconds sleep_dur(sleep_dur_ms);
+        double time_step_s = time_step_ms / 1000;
+        double step_wall_s = time_step_s / this->time_scale;
+        duration<double> frame_dur(1. / target_frame_rate);
         this->running_simulator = &*this->simulator;
+        this->unthrottled = unthrottled;
+
+        double accumulator = 0;
+        uint64_t steps = 0;
+        // heap allocations of the frames since the last report, not counting the report
+        uint64_t frame_allocations = 0;
+        vector<double> frame_intervals;
+        frame_intervals.reserve(4 * target_frame_rate);
+        auto last_frame = steady_clock::now();
+        auto last_report = last_frame;
 
-        uint frame_counter = 0;
         while (this->state.quit == false)
         {
-            //time_point<system_clock> now = system_clock::now();
-            this->running_simulator->simulate_next_frame((double)time_step_ms / 1000);
-            //sleep_until(now + sleep_dur);
-            sleep_for(sleep_dur);
+            auto frame_start = steady_clock::now();
+            double elapsed_s = duration<double>(frame_start - last_frame).count();
+            last_frame = frame_start;
+            frame_intervals.push_back(elapsed_s);
+            uint64_t allocations_start = utils::allocation_count().load(memory_order_relaxed);
+            this->arena.reset();
 
-            frame_counter++;
-            if (frame_counter*sleep_dur_ms >= (1./target_frame_rate)*1000.)
+            this->handle_events();
+            if (this->unthrottled)
             {
-                this->handle_events();
-                this->redraw_canvas();
-                frame_counter = 0;
+                do
+                {
+                    this->running_simulator->simulate_next_frame(time_step_s);
+                    steps++;
+                } while (steady_clock::now() - frame_start < frame_dur);
+                accumulator = 0;
             }
+            else
+            {
+                accumulator += min(elapsed_s, this->max_catch_up_s);
+                while (accumulator >= step_wall_s)
+                {
+                    this->running_simulator->simulate_next_frame(time_step_s);
+                    accumulator -= step_wall_s;
+                    steps++;
+                }
+            }
+            this->redraw_canvas();
+            frame_allocations += utils::allocation_count().load(memory_order_relaxed) - allocations_start;
+
+            double report_s = duration<double>(frame_start - last_report).count();
+            if (report_s >= 1)
+            {
+                this->run_stats.allocations_per_frame = (double)frame_allocations / frame_intervals.size();
+                report_run_stats(steps / report_s, frame_intervals, 1. / target_frame_rate);
+                frame_allocations = 0;
+                steps = 0;
+                frame_intervals.clear();
+                last_report = frame_start;
+            }
+
+            if (!this->unthrottled)
+                sleep_until(frame_start + frame_dur);
         }
 
         this->renderer.quit();
     }
 
+    // jitter is the standard deviation of the frame intervals from the target interval
+    void report_run_stats(double steps_per_s, const vector<double> &frame_intervals, double target_interval_s)
+    {
+        double deviation_sq = 0;
+        for (double interval : frame_intervals)
+            deviation_sq += (interval - target_interval_s) * (interval - target_interval_s);
+
+        this->run_stats.steps_per_s = steps_per_s;
+        this->run_stats.frame_rate = frame_intervals.size() / accumulate(frame_intervals.begin(), frame_intervals.end(), 0.);
+        this->run_stats.frame_jitter_ms = sqrt(deviation_sq / max(frame_intervals.size(), (size_t)1)) * 1000;
+        cout << "steps/s: " << this->run_stats.steps_per_s
+             << " frames/s: " << this->run_stats.frame_rate
+             << " frame jitter ms: " << this->run_stats.frame_jitter_ms
+             << " bodies awake: " << this->simulator->get_awake_body_count()
+             << " sleeping: " << this->simulator->get_sleeping_body_count();
+        // without the counting operator new there is nothing to report
+#ifdef COUNT_ALLOCATIONS
+        cout << " allocations per frame: " << this->run_stats.allocations_per_frame;
+#endif
+        cout << " view rebuilds: " << this->view.get_rebuilds()
+             << " arena KB: " << this->arena.get_capacity() / 1e3
+             << (this->unthrottled ? " (unthrottled)" : "") << endl;
+    }
+
     void simulation_run_frame_by_frame(int time_step_ms)
     {
         for (;;)
@@ -0,0 +1,61 @@
+#include <bits/stdc++.h>
+
+#ifndef UTILS_ALLOCATION_COUNTER_CPP_
+#define UTILS_ALLOCATION_COUNTER_CPP_
+
+using namespace std;
+
+namespace utils {
+    // Calls of the global operator new so far, for checking that a code path allocates nothing. Allocations of C
+    // libraries through malloc aren't counted. Stays 0 unless the program counts them, see COUNT_ALLOCATIONS.
+    inline atomic<uint64_t> &allocation_count()
+    {
+        static atomic<uint64_t> count{0};
+        return count;
+    }
+}
+
+// The file with main defines COUNT_ALLOCATIONS before including this file, or is compiled with -DCOUNT_ALLOCATIONS,
+// to replace the global operator new and delete with counting ones. Only one file of a program may do so.
+#ifdef COUNT_ALLOCATIONS
+// the memory of operator new comes from malloc, GCC can't tell when the calls are inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(size_t size)
+{
+    utils::allocation_count().fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size > 0 ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+#pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+#include <bits/stdc++.h>
+
+#ifndef UTILS_ARENA_CPP_
+#define UTILS_ARENA_CPP_
+
+using namespace std;
+
+namespace utils {
+    // Bump allocator for memory that is all given back at once by reset, like the temporaries of a frame. Only
+    // for trivially destructible types, nothing is destroyed. When the block is full another one is added, reset
+    // then replaces the blocks by one as large as all of them, so frames needing no more than the frames before
+    // allocate nothing.
+    class Arena
+    {
+    private:
+        vector<unique_ptr<char[]>> blocks;
+        vector<size_t> block_sizes;
+        size_t offset = 0;
+        // bytes handed out since the last reset
+        size_t used = 0;
+
+    public:
+        Arena(size_t initial_bytes = 1 << 16)
+        {
+            this->blocks.emplace_back(new char[initial_bytes]);
+            this->block_sizes.push_back(initial_bytes);
+        }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        // room for count uninitialized _T
+        template <typename _T>
+        _T *alloc(size_t count)
+        {
+            static_assert(is_trivially_destructible<_T>::value, "arena memory is never destroyed");
+            size_t align = alignof(_T);
+            size_t size = count * sizeof(_T);
+            size_t start = (this->offset + align - 1) / align * align;
+            if (start + size > this->block_sizes.back())
+            {
+                size_t block_size = max(size + align, this->block_sizes.back() * 2);
+                this->blocks.emplace_back(new char[block_size]);
+                this->block_sizes.push_back(block_size);
+                start = 0;
+            }
+            this->offset = start + size;
+            this->used += size;
+            return (_T *)(this->blocks.back().get() + start);
+        }
+
+        // gives back everything allocated since the last reset
+        void reset()
+        {
+            if (this->blocks.size() > 1)
+            {
+                size_t total = accumulate(this->block_sizes.begin(), this->block_sizes.end(), (size_t)0);
+                this->blocks.clear();
+                this->block_sizes.clear();
+                this->blocks.emplace_back(new char[total]);
+                this->block_sizes.push_back(total);
+            }
+            this->offset = 0;
+            this->used = 0;
+        }
+
+        size_t get_used()
+        {
+            return this->used;
+        }
+
+        size_t get_capacity()
+        {
+            return accumulate(this->block_sizes.begin(), this->block_sizes.end(), (size_t)0);
+        }
+    };
+}
+
+#endif
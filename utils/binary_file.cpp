@@ -0,0 +1,184 @@
+#include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef UTILS_BINARY_FILE_CPP_
+#define UTILS_BINARY_FILE_CPP_
+
+using namespace std;
+
+namespace utils {
+    // Writes fixed size values and whole arrays in native byte order. An array is its element count followed by
+    // its elements, padded to 8 bytes so that every array of a file stays aligned.
+    class BinaryWriter
+    {
+    private:
+        FILE *file = NULL;
+        bool ok = false;
+        uint64_t offset = 0;
+        vector<char> buffer;
+
+        void write_bytes(const void *data, size_t size)
+        {
+            if (this->ok && size > 0 && fwrite(data, 1, size, this->file) != size)
+                this->ok = false;
+            this->offset += size;
+        }
+
+    public:
+        BinaryWriter(const string &path)
+        {
+            this->file = fopen(path.c_str(), "wb");
+            this->ok = this->file != NULL;
+            if (this->ok)
+            {
+                this->buffer.resize(1 << 20);
+                setvbuf(this->file, this->buffer.data(), _IOFBF, this->buffer.size());
+            }
+        }
+
+        ~BinaryWriter()
+        {
+            close();
+        }
+
+        template <typename _T>
+        void write(const _T &value)
+        {
+            static_assert(is_trivially_copyable<_T>::value, "only plain values can be written");
+            write_bytes(&value, sizeof(_T));
+        }
+
+        template <typename _T>
+        void write_array(const vector<_T> &values)
+        {
+            static_assert(is_trivially_copyable<_T>::value, "only arrays of plain values can be written");
+            write<uint64_t>(values.size());
+            write_bytes(values.data(), values.size() * sizeof(_T));
+            static const char padding[8] = {};
+            write_bytes(padding, (8 - this->offset % 8) % 8);
+        }
+
+        // flushes and closes the file, false if anything failed to be written
+        bool close()
+        {
+            if (this->file != NULL)
+            {
+                if (fclose(this->file) != 0)
+                    this->ok = false;
+                this->file = NULL;
+            }
+            return this->ok;
+        }
+    };
+
+    // Reads a file written by BinaryWriter through a read-only memory map. Arrays are copied out with one memcpy
+    // each. Reads past the end fail and leave the reader failed, so a truncated file is noticed by checking good()
+    // once at the end.
+    class BinaryReader
+    {
+    private:
+        const char *data = NULL;
+        size_t size = 0;
+        size_t offset = 0;
+        bool ok = false;
+
+        const char *take(size_t size)
+        {
+            if (!this->ok || size > this->size - this->offset)
+            {
+                this->ok = false;
+                return NULL;
+            }
+            const char *p = this->data + this->offset;
+            this->offset += size;
+            return p;
+        }
+
+    public:
+        BinaryReader(const string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    madvise(p, st.st_size, MADV_SEQUENTIAL);
+                    this->data = (const char *)p;
+                    this->size = st.st_size;
+                    this->ok = true;
+                }
+            }
+            ::close(fd);
+        }
+
+        ~BinaryReader()
+        {
+            if (this->data != NULL)
+                munmap((void *)this->data, this->size);
+        }
+
+        BinaryReader(const BinaryReader &) = delete;
+        BinaryReader &operator=(const BinaryReader &) = delete;
+
+        template <typename _T>
+        bool read(_T *out)
+        {
+            static_assert(is_trivially_copyable<_T>::value, "only plain values can be read");
+            const char *p = take(sizeof(_T));
+            if (p != NULL)
+                memcpy(out, p, sizeof(_T));
+            return p != NULL;
+        }
+
+        template <typename _T>
+        bool read_array(vector<_T> *out)
+        {
+            static_assert(is_trivially_copyable<_T>::value, "only arrays of plain values can be read");
+            uint64_t count;
+            if (!read(&count) || count > (this->size - this->offset) / sizeof(_T))
+            {
+                this->ok = false;
+                return false;
+            }
+            out->resize(count);
+            memcpy(out->data(), take(count * sizeof(_T)), count * sizeof(_T));
+            take((8 - this->offset % 8) % 8);
+            return this->ok;
+        }
+
+        size_t tell()
+        {
+            return this->offset;
+        }
+
+        // the whole mapped file, for formats that are read in place
+        const char *get_data()
+        {
+            return this->data;
+        }
+
+        size_t get_size()
+        {
+            return this->size;
+        }
+
+        void seek(size_t offset)
+        {
+            this->offset = min(offset, this->size);
+        }
+
+        bool good()
+        {
+            return this->ok;
+        }
+    };
+}
+
+#endif
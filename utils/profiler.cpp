@@ -0,0 +1,213 @@
+#include <bits/stdc++.h>
+#include <mutex>
+
+#ifndef UTILS_PROFILER_CPP_
+#define UTILS_PROFILER_CPP_
+
+using namespace std;
+
+// times the rest of the enclosing scope as the phase name, a string literal
+#define PROFILE_SCOPE(name) utils::ProfileScope profile_scope_(name)
+
+namespace utils {
+    // Timings of named phases, recorded by PROFILE_SCOPE. Every thread records into its own ring of the last
+    // RING_EVENTS timings without locking, older timings are overwritten. Disabled, a scope costs a relaxed load
+    // of the enabled flag.
+    //
+    // The rings are read while threads record into them, timings overwritten during the read are left out.
+    // The rings of threads that exited are reused by new threads and keep their timings.
+    class Profiler
+    {
+    public:
+        struct event_t
+        {
+            const char *name;
+            uint64_t start_ns;
+            uint64_t end_ns;
+            uint thread;
+        };
+
+        static const uint RING_EVENTS = 1 << 16;
+
+    private:
+        struct ring_t
+        {
+            event_t events[RING_EVENTS];
+            // timings recorded so far, the last RING_EVENTS of them are in events
+            atomic<uint64_t> count{0};
+            // timings before this one were cleared
+            atomic<uint64_t> cleared{0};
+            atomic<bool> in_use{true};
+            uint thread;
+        };
+
+        struct state_t
+        {
+            atomic<bool> enabled{false};
+            mutex lock;
+            vector<unique_ptr<ring_t>> rings;
+            chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+        };
+
+        // frees the thread's ring when the thread exits
+        struct thread_ring_t
+        {
+            ring_t *ring = NULL;
+            ~thread_ring_t()
+            {
+                if (this->ring != NULL)
+                    this->ring->in_use.store(false, memory_order_release);
+            }
+        };
+
+        static state_t &state()
+        {
+            static state_t s;
+            return s;
+        }
+
+        static ring_t *thread_ring()
+        {
+            static thread_local thread_ring_t tl;
+            if (tl.ring != NULL)
+                return tl.ring;
+
+            state_t &s = state();
+            lock_guard<mutex> lock(s.lock);
+            for (unique_ptr<ring_t> &ring : s.rings)
+            {
+                bool in_use = false;
+                if (ring->in_use.compare_exchange_strong(in_use, true))
+                    return tl.ring = ring.get();
+            }
+            s.rings.emplace_back(new ring_t());
+            s.rings.back()->thread = s.rings.size() - 1;
+            return tl.ring = s.rings.back().get();
+        }
+
+    public:
+        static bool is_enabled()
+        {
+            return state().enabled.load(memory_order_relaxed);
+        }
+
+        static void set_enabled(bool enabled)
+        {
+            state().enabled.store(enabled, memory_order_relaxed);
+        }
+
+        static uint64_t now_ns()
+        {
+            return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - state().epoch).count();
+        }
+
+        static void record(const char *name, uint64_t start_ns, uint64_t end_ns)
+        {
+            ring_t *ring = thread_ring();
+            uint64_t count = ring->count.load(memory_order_relaxed);
+            ring->events[count % RING_EVENTS] = {name, start_ns, end_ns, ring->thread};
+            ring->count.store(count + 1, memory_order_release);
+        }
+
+        // the timings in the rings, thread after thread and oldest first
+        static vector<event_t> get_events()
+        {
+            state_t &s = state();
+            lock_guard<mutex> lock(s.lock);
+            vector<event_t> events;
+            for (unique_ptr<ring_t> &ring : s.rings)
+            {
+                uint64_t end = ring->count.load(memory_order_acquire);
+                uint64_t begin = max(end > RING_EVENTS ? end - RING_EVENTS : 0, ring->cleared.load(memory_order_relaxed));
+                begin = min(begin, end);
+                size_t first = events.size();
+                for (uint64_t i = begin; i < end; i++)
+                    events.push_back(ring->events[i % RING_EVENTS]);
+
+                // a timing recorded during the copy may have overwritten the oldest ones
+                uint64_t after = ring->count.load(memory_order_acquire);
+                uint64_t overwritten = after > RING_EVENTS ? after - RING_EVENTS : 0;
+                if (overwritten > begin)
+                    events.erase(events.begin() + first, events.begin() + first + min(overwritten - begin, end - begin));
+            }
+            return events;
+        }
+
+        // forgets every timing
+        static void clear()
+        {
+            state_t &s = state();
+            lock_guard<mutex> lock(s.lock);
+            for (unique_ptr<ring_t> &ring : s.rings)
+                ring->cleared.store(ring->count.load(memory_order_acquire), memory_order_relaxed);
+        }
+
+        // Writes the timings as complete events of the Chrome trace event format, for chrome://tracing and
+        // Perfetto. False if the file couldn't be written.
+        static bool write_chrome_trace(const string &path)
+        {
+            vector<event_t> events = get_events();
+            ofstream out(path);
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            out << setprecision(15);
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                const event_t &e = events[i];
+                out << (i ? ",\n" : "\n")
+                    << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                    << ",\"ts\":" << e.start_ns / 1000. << ",\"dur\":" << (e.end_ns - e.start_ns) / 1000. << "}";
+            }
+            out << "\n]}\n";
+            return (bool)out;
+        }
+
+        // Prints the count, total and the median, 99th percentile and longest duration of every phase over the
+        // timings in the rings.
+        static void print_summary(ostream &out)
+        {
+            map<string, vector<uint64_t>> phases;
+            for (const event_t &e : get_events())
+                phases[e.name].push_back(e.end_ns - e.start_ns);
+
+            out << "phase                                    count     total ms   p50 us     p99 us     max us" << endl;
+            for (auto &phase : phases)
+            {
+                vector<uint64_t> &d = phase.second;
+                sort(d.begin(), d.end());
+                auto percentile = [&](double p) { return d[min((size_t)(p * d.size()), d.size() - 1)] / 1000.; };
+                out << left << setw(40) << phase.first << " " << right
+                    << setw(9) << d.size() << " "
+                    << setw(12) << accumulate(d.begin(), d.end(), (uint64_t)0) / 1e6 << " "
+                    << setw(10) << percentile(0.5) << " "
+                    << setw(10) << percentile(0.99) << " "
+                    << setw(10) << d.back() / 1000. << endl;
+            }
+        }
+    };
+
+    // Records the time from its construction to its destruction, see PROFILE_SCOPE.
+    class ProfileScope
+    {
+    private:
+        const char *name = NULL;
+        uint64_t start_ns;
+
+    public:
+        ProfileScope(const char *name)
+        {
+            if (Profiler::is_enabled())
+            {
+                this->name = name;
+                this->start_ns = Profiler::now_ns();
+            }
+        }
+
+        ~ProfileScope()
+        {
+            if (this->name != NULL)
+                Profiler::record(this->name, this->start_ns, Profiler::now_ns());
+        }
+    };
+}
+
+#endif
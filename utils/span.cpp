@@ -0,0 +1,30 @@
+#include <bits/stdc++.h>
+
+#ifndef UTILS_SPAN_CPP_
+#define UTILS_SPAN_CPP_
+
+using namespace std;
+
+namespace utils {
+    // Read-only view of count contiguous items owned by someone else, who says how long it stays valid.
+    template <typename _T>
+    class span
+    {
+    private:
+        const _T *items = NULL;
+        size_t count = 0;
+
+    public:
+        span() {}
+        span(const _T *items, size_t count) : items(items), count(count) {}
+
+        const _T &operator[](size_t i) const { return this->items[i]; }
+        const _T *data() const { return this->items; }
+        size_t size() const { return this->count; }
+        bool empty() const { return this->count == 0; }
+        const _T *begin() const { return this->items; }
+        const _T *end() const { return this->items + this->count; }
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include <bits/stdc++.h>
+#include "vectors.cpp"
+
+#ifndef UTILS_SPATIAL_HASH_CPP_
+#define UTILS_SPATIAL_HASH_CPP_
+
+using namespace std;
+
+namespace utils {
+    // Uniform grid of cells stored in a hash table, every item sits in the cell of its position.
+    // Items are kept in doubly linked lists per cell, so moving an item costs O(1) and update only touches items
+    // that changed cells since the last step. Queries don't modify anything and can run on many threads at once.
+    class SpatialHash
+    {
+    private:
+        typedef vectors::fixed_vector<int, DIMENSIONS> cell_t;
+
+        struct bucket_t
+        {
+            cell_t cell;
+            int head = -1; // first item, -1 for none
+            bool used = false;
+        };
+
+        double cell_size = 1;
+        vector<bucket_t> buckets; // open addressing, size is a power of 2
+        uint used_buckets = 0;
+
+        vector<cell_t> item_cell;
+        vector<int> item_bucket; // -1 while not inserted
+        vector<int> next;
+        vector<int> prev;
+
+        // Positions past the int range, like a body that blew up, share the cells at its ends and NaN goes to the
+        // lowest one, instead of an undefined cast. Half the range leaves room for the neighbours of query.
+        cell_t cell_of(const vectors::vec_t &position) const
+        {
+            const double max_cell = INT_MAX / 2;
+            cell_t c;
+            for (uint d = 0; d < DIMENSIONS; d++)
+                c[d] = (int)fmin(fmax(floor(position[d] / this->cell_size), -max_cell), max_cell);
+            return c;
+        }
+
+        static uint hash(const cell_t &c)
+        {
+            static const uint primes[] = {73856093u, 19349663u, 83492791u};
+            uint h = 0;
+            for (uint d = 0; d < DIMENSIONS; d++)
+                h ^= (uint)c[d] * primes[d % 3];
+            return h;
+        }
+
+        // bucket of cell c, or the free bucket where it would go
+        uint find(const cell_t &c) const
+        {
+            uint mask = this->buckets.size() - 1;
+            uint b = hash(c) & mask;
+            while (this->buckets[b].used && !(this->buckets[b].cell == c))
+                b = (b + 1) & mask;
+            return b;
+        }
+
+        void unlink(uint item)
+        {
+            int b = this->item_bucket[item];
+            if (b < 0)
+                return;
+            if (this->prev[item] >= 0)
+                this->next[this->prev[item]] = this->next[item];
+            else
+                this->buckets[b].head = this->next[item];
+            if (this->next[item] >= 0)
+                this->prev[this->next[item]] = this->prev[item];
+            this->item_bucket[item] = -1;
+        }
+
+        void link(uint item, const cell_t &c)
+        {
+            uint b = find(c);
+            if (!this->buckets[b].used)
+            {
+                this->buckets[b].used = true;
+                this->buckets[b].cell = c;
+                this->buckets[b].head = -1;
+                this->used_buckets++;
+            }
+            this->prev[item] = -1;
+            this->next[item] = this->buckets[b].head;
+            if (this->buckets[b].head >= 0)
+                this->prev[this->buckets[b].head] = item;
+            this->buckets[b].head = item;
+            this->item_bucket[item] = b;
+            this->item_cell[item] = c;
+        }
+
+        // empty cells stay in the table until it fills up, then the table is rebuilt from the items
+        void rehash()
+        {
+            uint live = 0;
+            for (const bucket_t &b : this->buckets)
+                if (b.used && b.head >= 0)
+                    live++;
+
+            uint capacity = 16;
+            while (capacity < 4 * live)
+                capacity *= 2;
+            this->buckets.assign(capacity, bucket_t());
+            this->used_buckets = 0;
+
+            for (uint i = 0; i < this->item_cell.size(); i++)
+                if (this->item_bucket[i] >= 0)
+                    link(i, this->item_cell[i]);
+        }
+
+    public:
+        // Removes every item and sets the number of items and the cell size.
+        void reset(uint item_count, double cell_size)
+        {
+            this->cell_size = cell_size;
+            this->item_cell.assign(item_count, cell_t{});
+            this->item_bucket.assign(item_count, -1);
+            this->next.assign(item_count, -1);
+            this->prev.assign(item_count, -1);
+            uint capacity = 16;
+            while (capacity < 2 * item_count)
+                capacity *= 2;
+            this->buckets.assign(capacity, bucket_t());
+            this->used_buckets = 0;
+        }
+
+        double get_cell_size() const
+        {
+            return this->cell_size;
+        }
+
+        uint size() const
+        {
+            return this->item_cell.size();
+        }
+
+        // Puts item in the cell of position, nothing happens if it's already there.
+        void update(uint item, const vectors::vec_t &position)
+        {
+            cell_t c = cell_of(position);
+            if (this->item_bucket[item] >= 0 && this->item_cell[item] == c)
+                return;
+
+            unlink(item);
+            if (2 * (this->used_buckets + 1) > this->buckets.size())
+                rehash();
+            link(item, c);
+        }
+
+        // Calls fn(item) for every item in the cell of position and the cells around it.
+        template <typename _F>
+        void query(const vectors::vec_t &position, const _F &fn) const
+        {
+            cell_t center = cell_of(position);
+            cell_t c;
+            uint neighbours = 1;
+            for (uint d = 0; d < DIMENSIONS; d++)
+                neighbours *= 3;
+
+            for (uint n = 0; n < neighbours; n++)
+            {
+                uint rest = n;
+                for (uint d = 0; d < DIMENSIONS; d++)
+                {
+                    c[d] = center[d] + (int)(rest % 3) - 1;
+                    rest /= 3;
+                }
+
+                const bucket_t &b = this->buckets[find(c)];
+                if (!b.used)
+                    continue;
+                for (int item = b.head; item >= 0; item = this->next[item])
+                    fn((uint)item);
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include <bits/stdc++.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef UTILS_THREAD_POOL_CPP_
+#define UTILS_THREAD_POOL_CPP_
+
+using namespace std;
+
+namespace utils {
+    // Persistent work-stealing pool of worker threads.
+    // Every worker has its own task queue, it takes its newest task first and steals the oldest task of another
+    // queue when its own is empty. A thread waiting for its tasks runs queued tasks in the meantime, so a task
+    // may call parallel_for itself without blocking a worker.
+    class ThreadPool
+    {
+    private:
+        struct task_t
+        {
+            void (*call)(const void *ctx, uint begin, uint end);
+            const void *ctx;
+            uint begin, end;
+            atomic<uint> *pending;
+        };
+
+        // fixed size ring of tasks, so queueing never allocates
+        struct task_queue_t
+        {
+            static const uint capacity = 1024;
+            mutex m;
+            task_t tasks[capacity];
+            uint head = 0; // oldest task
+            uint count = 0;
+        };
+
+        vector<thread> workers;
+        // queues[0] is used by threads outside the pool, queues[i] by worker i
+        vector<unique_ptr<task_queue_t>> queues;
+        atomic<uint> queued_tasks;
+        bool stop = false;
+        mutex sleep_m;
+        condition_variable sleep_cv;
+
+        static const uint CHUNKS_PER_THREAD = 4;
+
+        static uint &current_queue(const ThreadPool *pool)
+        {
+            static thread_local const ThreadPool *tl_pool = NULL;
+            static thread_local uint tl_queue = 0;
+            if (tl_pool != pool)
+            {
+                tl_pool = pool;
+                tl_queue = 0;
+            }
+            return tl_queue;
+        }
+
+        bool push(uint q, const task_t &t)
+        {
+            task_queue_t &queue = *this->queues[q];
+            lock_guard<mutex> lock(queue.m);
+            if (queue.count == task_queue_t::capacity)
+                return false;
+            queue.tasks[(queue.head + queue.count) % task_queue_t::capacity] = t;
+            queue.count++;
+            return true;
+        }
+
+        bool pop_newest(uint q, task_t *out)
+        {
+            task_queue_t &queue = *this->queues[q];
+            lock_guard<mutex> lock(queue.m);
+            if (queue.count == 0)
+                return false;
+            queue.count--;
+            *out = queue.tasks[(queue.head + queue.count) % task_queue_t::capacity];
+            return true;
+        }
+
+        bool steal_oldest(uint q, task_t *out)
+        {
+            task_queue_t &queue = *this->queues[q];
+            lock_guard<mutex> lock(queue.m);
+            if (queue.count == 0)
+                return false;
+            *out = queue.tasks[queue.head];
+            queue.head = (queue.head + 1) % task_queue_t::capacity;
+            queue.count--;
+            return true;
+        }
+
+        bool find_task(uint q, task_t *out)
+        {
+            if (this->queued_tasks.load(memory_order_acquire) == 0)
+                return false;
+
+            bool found = pop_newest(q, out);
+            for (uint i = 1; !found && i < this->queues.size(); i++)
+                found = steal_oldest((q + i) % this->queues.size(), out);
+
+            if (found)
+                this->queued_tasks.fetch_sub(1, memory_order_relaxed);
+            return found;
+        }
+
+        static void run(const task_t &t)
+        {
+            t.call(t.ctx, t.begin, t.end);
+            t.pending->fetch_sub(1, memory_order_release);
+        }
+
+        void worker_loop(uint q)
+        {
+            current_queue(this) = q;
+            task_t t;
+            for (;;)
+            {
+                if (find_task(q, &t))
+                {
+                    run(t);
+                    continue;
+                }
+
+                unique_lock<mutex> lock(this->sleep_m);
+                this->sleep_cv.wait(lock, [&] { return this->stop || this->queued_tasks.load() > 0; });
+                if (this->stop)
+                    return;
+            }
+        }
+
+        // runs queued tasks until every task counted by pending is done
+        void wait(atomic<uint> &pending)
+        {
+            uint q = current_queue(this);
+            task_t t;
+            while (pending.load(memory_order_acquire) > 0)
+            {
+                if (find_task(q, &t))
+                    run(t);
+                else
+                    this_thread::yield();
+            }
+        }
+
+    public:
+        ThreadPool(uint thread_count) : queued_tasks(0)
+        {
+            thread_count = max(thread_count, 1u);
+            for (uint i = 0; i < thread_count; i++)
+                this->queues.emplace_back(new task_queue_t());
+            for (uint i = 1; i < thread_count; i++)
+                this->workers.emplace_back(&ThreadPool::worker_loop, this, i);
+        }
+
+        ~ThreadPool()
+        {
+            {
+                lock_guard<mutex> lock(this->sleep_m);
+                this->stop = true;
+            }
+            this->sleep_cv.notify_all();
+            for (thread &t : this->workers)
+                t.join();
+        }
+
+        uint get_thread_count()
+        {
+            return this->workers.size() + 1;
+        }
+
+        // Calls fn(begin, end) for disjoint ranges covering [0, n), each range is a task that any thread may run.
+        // max_chunks limits how many ranges n is split into, by default a few per thread.
+        template <typename _F>
+        void parallel_for(uint n, const _F &fn, uint max_chunks = 0)
+        {
+            if (max_chunks == 0)
+                max_chunks = get_thread_count() * CHUNKS_PER_THREAD;
+            uint chunks = min(min(n, max_chunks), task_queue_t::capacity / 2);
+            if (this->workers.empty() || chunks < 2)
+            {
+                if (n > 0)
+                    fn(0, n);
+                return;
+            }
+
+            auto call = [](const void *ctx, uint begin, uint end) { (*(const _F *)ctx)(begin, end); };
+            auto chunk_begin = [&](uint chunk) { return (uint)((uint64_t)n * chunk / chunks); };
+            uint q = current_queue(this);
+            atomic<uint> pending(0);
+
+            // queue chunks 1.., chunk 0 is run by the calling thread, chunks that don't fit the queue too
+            for (uint c = chunks - 1; c > 0; c--)
+            {
+                task_t t = {call, &fn, chunk_begin(c), chunk_begin(c + 1), &pending};
+                pending.fetch_add(1, memory_order_relaxed);
+                this->queued_tasks.fetch_add(1, memory_order_release);
+                if (!push(q, t))
+                {
+                    this->queued_tasks.fetch_sub(1, memory_order_relaxed);
+                    run(t);
+                }
+            }
+            {
+                lock_guard<mutex> lock(this->sleep_m);
+                this->sleep_cv.notify_all();
+            }
+
+            fn(chunk_begin(0), chunk_begin(1));
+            wait(pending);
+        }
+    };
+}
+
+#endif
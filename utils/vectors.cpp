@@ -3,89 +3,156 @@
 #ifndef UTILS_VECTORS_CPP_
 #define UTILS_VECTORS_CPP_
 
+// number of spatial dimensions, compile with -DDIMENSIONS=3 for 3D
+#ifndef DIMENSIONS
+#define DIMENSIONS 2
+#endif
+
 using namespace std;
 
 namespace utils::vectors {
-template <typename _T = double>
-    vector<_T> vector_sum(vector<_T> vect1, vector<_T> vect2)
+    // Fixed size vector stored inline, so none of the operations below touch the heap.
+    template <typename _T, uint _N>
+    struct fixed_vector
     {
-        // if vectors have differing dimensionality (should never actually be the case)
-        if (vect2.size() > vect1.size()) {
-            auto v1 = vect1;
-            vect1 = vect2;
-            vect2 = v1;
-        }
+        _T c[_N];
 
-        for (uint i = 0; i < vect2.size(); i++)
-            vect1[i] += vect2[i];
+        constexpr _T &operator[](uint i) { return c[i]; }
+        constexpr const _T &operator[](uint i) const { return c[i]; }
+        constexpr uint size() const { return _N; }
+    };
 
-        return vect1;
+    typedef fixed_vector<double, DIMENSIONS> vec_t;
+
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> operator+(const fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
+    {
+        fixed_vector<_T, _N> r{};
+        for (uint i = 0; i < _N; i++)
+            r[i] = vect1[i] + vect2[i];
+        return r;
     }
 
-    template <typename _T = double>
-    vector<_T> vector_sub(vector<_T> vect1, vector<_T> vect2)
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> operator-(const fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
     {
-        // if vectors have differing dimensionality (should never actually be the case)
-        if (vect2.size() > vect1.size()) {
-            auto v1 = vect1;
-            vect1 = vect2;
-            vect2 = v1;
-        }
+        fixed_vector<_T, _N> r{};
+        for (uint i = 0; i < _N; i++)
+            r[i] = vect1[i] - vect2[i];
+        return r;
+    }
 
-        for (uint i = 0; i < vect2.size(); i++)
-            vect1[i] -= vect2[i];
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> operator-(const fixed_vector<_T, _N> &vect)
+    {
+        fixed_vector<_T, _N> r{};
+        for (uint i = 0; i < _N; i++)
+            r[i] = -vect[i];
+        return r;
+    }
 
-        return vect1;
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> operator*(const fixed_vector<_T, _N> &vect, _T scalar)
+    {
+        fixed_vector<_T, _N> r{};
+        for (uint i = 0; i < _N; i++)
+            r[i] = vect[i] * scalar;
+        return r;
     }
 
-    template <typename _T = double>
-    double vector_len(vector<_T> vect)
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> operator*(_T scalar, const fixed_vector<_T, _N> &vect)
     {
-        _T component_squares_sum = 0;
-        for (_T comp : vect)
-            component_squares_sum += pow(comp, 2);
+        return vect * scalar;
+    }
 
-        return (double)sqrt(component_squares_sum);
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> &operator+=(fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
+    {
+        for (uint i = 0; i < _N; i++)
+            vect1[i] += vect2[i];
+        return vect1;
     }
 
-    template <typename _T = double>
-    vector<_T> scale_vector(vector<_T> vect, _T scalar)
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> &operator-=(fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
     {
-        for (uint i = 0; i < vect.size(); i++)
-            vect[i] *= scalar;
+        for (uint i = 0; i < _N; i++)
+            vect1[i] -= vect2[i];
+        return vect1;
+    }
 
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> &operator*=(fixed_vector<_T, _N> &vect, _T scalar)
+    {
+        for (uint i = 0; i < _N; i++)
+            vect[i] *= scalar;
         return vect;
     }
 
-    template <typename _T = double>
-    vector<_T> unit_vector(vector<_T> vect)
+    template <typename _T, uint _N>
+    constexpr bool operator==(const fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
     {
-        double length = vector_len(vect);
-        if (length == 0)
-            return vector<double>({0., 0.});
+        for (uint i = 0; i < _N; i++)
+            if (vect1[i] != vect2[i])
+                return false;
+        return true;
+    }
 
-        return scale_vector(vect, 1 / length);
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> vector_sum(const fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
+    {
+        return vect1 + vect2;
+    }
+
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> vector_sub(const fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
+    {
+        return vect1 - vect2;
+    }
+
+    template <typename _T, uint _N>
+    constexpr fixed_vector<_T, _N> scale_vector(const fixed_vector<_T, _N> &vect, _T scalar)
+    {
+        return vect * scalar;
     }
 
-    template <typename _T = double>
-    double dot_product(vector<_T> vect1, vector<_T> vect2)
+    template <typename _T, uint _N>
+    constexpr double dot_product(const fixed_vector<_T, _N> &vect1, const fixed_vector<_T, _N> &vect2)
     {
         double dp = 0;
-        for (uint i = 0; i < vect1.size(); i++)
+        for (uint i = 0; i < _N; i++)
             dp += vect1[i] * vect2[i];
 
         return dp;
     }
 
-    template <typename _T = double>
-    vector<_T> project_vector(vector<_T> vect_a, vector<_T> vect_b)
+    template <typename _T, uint _N>
+    inline double vector_len(const fixed_vector<_T, _N> &vect)
+    {
+        return sqrt(dot_product(vect, vect));
+    }
+
+    template <typename _T, uint _N>
+    inline fixed_vector<_T, _N> unit_vector(const fixed_vector<_T, _N> &vect)
+    {
+        double length = vector_len(vect);
+        if (length == 0)
+            return fixed_vector<_T, _N>{};
+
+        return vect * (1 / length);
+    }
+
+    template <typename _T, uint _N>
+    inline fixed_vector<_T, _N> project_vector(const fixed_vector<_T, _N> &vect_a, const fixed_vector<_T, _N> &vect_b)
     {
         // Project a onto b and return the result.
-        //  (unit vector of b) multiplied by (dot product of (unit vector of b) and (vector a))
-        vector<_T> u_b = unit_vector<_T>(vect_b);
-        double a1 = dot_product<_T>(vect_a, u_b);
-        vector<_T> proj = scale_vector<_T>(u_b, a1);
-        return proj;
+        //  b multiplied by (dot product of a and b) / (squared length of b), same as projecting onto the unit vector of b
+        double b_len_sq = dot_product(vect_b, vect_b);
+        if (b_len_sq == 0)
+            return fixed_vector<_T, _N>{};
+
+        return vect_b * (dot_product(vect_a, vect_b) / b_len_sq);
     }
 }
 